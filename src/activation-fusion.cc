@@ -0,0 +1,79 @@
+#include "activation-fusion.h"
+
+namespace nnt {
+
+ActivationFunctionType ActivationFusion::ActivationOf(const Operator& op) {
+  // TANH has no fused code on NNAPI, so it stays a standalone operator
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::RELU:
+      return ActivationFunctionType::RELU;
+      break;
+
+    case BuiltinOperator::RELU1:
+      return ActivationFunctionType::RELU1;
+      break;
+
+    case BuiltinOperator::RELU6:
+      return ActivationFunctionType::RELU6;
+      break;
+
+    default:
+      return ActivationFunctionType::NONE;
+  }
+}
+
+int ActivationFusion::Run() {
+  std::vector<Operator>& operators = graph_.Operators();
+
+  // an activation that was fused writes through the operator it was fused
+  // into, so a second activation on a chain finds the real producer
+  std::vector<int> fused_into(operators.size(), -1);
+  std::vector<bool> removed(operators.size(), false);
+  int count = 0;
+
+  for (size_t op = 0; op < operators.size(); op++) {
+    Operator& activation_op = operators[op];
+    ActivationFunctionType activation = ActivationOf(activation_op);
+
+    if (activation == ActivationFunctionType::NONE ||
+        activation_op.inputs().size() != 1 ||
+        activation_op.outputs().size() != 1) {
+      continue;
+    }
+
+    // the intermediate tensor must exist only to feed the activation
+    int tensor = activation_op.inputs()[0];
+    if (tensor < 0 || index_.Producer(tensor) < 0 ||
+        index_.NumConsumers(tensor) != 1 || index_.IsGraphOutput(tensor)) {
+      continue;
+    }
+
+    int producer = index_.Producer(tensor);
+    if (removed[producer]) {
+      producer = fused_into[producer];
+    }
+
+    Operator& producer_op = operators[producer];
+    if (producer_op.outputs().size() != 1) {
+      continue;
+    }
+
+    ActivationFunctionType* fused = FusedActivation(producer_op);
+    if (fused == nullptr || *fused != ActivationFunctionType::NONE) {
+      continue;
+    }
+
+    *fused = activation;
+
+    int output = activation_op.outputs()[0];
+    producer_op.SetOutputs(std::vector<int>{output});
+    fused_into[op] = producer;
+    removed[op] = true;
+    ++count;
+  }
+
+  graph_.RemoveOperators(removed);
+  return count;
+}
+
+}
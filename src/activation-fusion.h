@@ -0,0 +1,34 @@
+#ifndef NNT_ACTIVATION_FUSION_H
+#define NNT_ACTIVATION_FUSION_H
+
+#include "model.h"
+#include "graph-index.h"
+
+namespace nnt {
+
+// Folds a standalone RELU, RELU1 or RELU6 operator into the
+// fused_activation_function of the operator that produces its input, when
+// that operator has no activation yet and the intermediate tensor is only
+// read by the activation. The producer writes directly on the output of the
+// activation, and the activation operator is removed from the graph.
+class ActivationFusion {
+ public:
+  ActivationFusion(Graph& graph, const GraphIndex& index)
+    : graph_(graph)
+    , index_(index) {}
+
+  // returns the number of activations fused
+  int Run();
+
+ private:
+  // activation equivalent to the standalone operator, NONE if the operator
+  // is not an activation that can be fused
+  ActivationFunctionType ActivationOf(const Operator& op);
+
+  Graph& graph_;
+  const GraphIndex& index_;
+};
+
+}
+
+#endif  // NNT_ACTIVATION_FUSION_H
@@ -0,0 +1,353 @@
+#include "affine-folding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace nnt {
+
+template<class T>
+static std::vector<u_char> ToBytes(const std::vector<T>& values) {
+  std::vector<u_char> data(values.size() * sizeof(T));
+  std::memcpy(data.data(), values.data(), data.size());
+  return data;
+}
+
+static bool IsQuantized(const Tensor& tensor) {
+  return tensor.HasQuantization() && !tensor.quantization().scale.empty();
+}
+
+void AffineFolding::SetTensorData(int index, std::vector<u_char>&& data) {
+  uint buffer_index = model_.AddBuffer(std::move(data));
+  Tensor& tensor = model_.graph().Tensors()[index];
+
+  tensor.SetBuffer(model_.Buffers()[buffer_index], buffer_index);
+}
+
+bool AffineFolding::ChannelValues(const Tensor& constant, int channels,
+    std::vector<float>& values) {
+  const std::vector<int>& shape = constant.shape();
+
+  // a scalar or a vector along the channels, any other dimension is 1
+  for (size_t i = 0; i + 1 < shape.size(); i++) {
+    if (shape[i] != 1) {
+      return false;
+    }
+  }
+
+  int count = shape.empty() ? 1 : shape.back();
+  if (count != 1 && count != channels) {
+    return false;
+  }
+
+  if (constant.tensor_type() == TensorType::FLOAT32 && !IsQuantized(constant)) {
+    values = ReadBuffer<float>(constant.buffer());
+  } else if (constant.tensor_type() == TensorType::UINT8 &&
+      IsQuantized(constant) && !constant.quantization().PerChannel()) {
+    const QuantizationParameters& quant = constant.quantization();
+    float zero_point = quant.zero_point.empty() ? 0 : quant.zero_point[0];
+
+    values.clear();
+    for (uint8_t q : ReadBuffer<uint8_t>(constant.buffer())) {
+      values.push_back((q - zero_point) * quant.scale[0]);
+    }
+  } else {
+    return false;
+  }
+
+  if (static_cast<int>(values.size()) != count) {
+    return false;
+  }
+
+  values.resize(channels, values[0]);
+  return true;
+}
+
+int AffineFolding::BiasTensor(Operator& op, int channels) {
+  std::vector<int> inputs = op.inputs();
+
+  if (inputs.size() > 2 && inputs[2] >= 0) {
+    return inputs[2];
+  }
+
+  Graph& graph = model_.graph();
+  const Tensor& input = graph.Tensors()[inputs[0]];
+  const Tensor& filter = graph.Tensors()[inputs[1]];
+
+  // a zero bias, with the type and scale the operator expects
+  TensorType type = TensorType::FLOAT32;
+  std::unique_ptr<QuantizationParameters> quant;
+
+  if (filter.tensor_type() == TensorType::UINT8) {
+    type = TensorType::INT32;
+    quant = std::make_unique<QuantizationParameters>();
+    quant->scale.push_back(input.quantization().scale[0] *
+        filter.quantization().scale[0]);
+    quant->zero_point.push_back(0);
+  }
+
+  std::vector<u_char> data(channels * TensorTypeSize(type), 0);
+  uint buffer_index = model_.AddBuffer(std::move(data));
+  std::string name = filter.name() + "_bias";
+
+  graph.AddTensor(Tensor(std::vector<int>{channels}, type, name,
+      model_.Buffers()[buffer_index], buffer_index, std::move(quant)));
+
+  int index = graph.Tensors().size() - 1;
+
+  inputs.resize(3);
+  inputs[2] = index;
+  op.SetInputs(std::move(inputs));
+
+  return index;
+}
+
+bool AffineFolding::FoldFloat(Operator& op, bool is_mul,
+    const std::vector<float>& values) {
+  int channels = values.size();
+  int filter_index = op.inputs()[1];
+  bool has_bias = op.inputs().size() > 2 && op.inputs()[2] >= 0;
+
+  // the constants are changed on place, so they can't be shared
+  if (NumConsumers(filter_index) != 1 ||
+      (has_bias && NumConsumers(op.inputs()[2]) != 1)) {
+    return false;
+  }
+
+  // the bias and the filter are checked before any of them changes, a fold
+  // that fails halfway would leave the filter scaled and the MUL on the graph
+  std::vector<float> bias(channels, 0.0f);
+
+  if (has_bias) {
+    bias = ReadBuffer<float>(
+        model_.graph().Tensors()[op.inputs()[2]].buffer());
+
+    if (static_cast<int>(bias.size()) != channels) {
+      return false;
+    }
+  }
+
+  if (is_mul) {
+    const Tensor& filter = model_.graph().Tensors()[filter_index];
+    std::vector<float> weights = ReadBuffer<float>(filter.buffer());
+
+    if (weights.size() % channels != 0) {
+      return false;
+    }
+
+    // depthwise filters are [1, h, w, channels], the others have the output
+    // channels on the first dimension
+    bool depthwise =
+        op.op_code().builtin_code == BuiltinOperator::DEPTHWISE_CONV_2D;
+    size_t per_channel = weights.size() / channels;
+
+    for (size_t i = 0; i < weights.size(); i++) {
+      weights[i] *= values[depthwise ? i % channels : i / per_channel];
+    }
+
+    SetTensorData(filter_index, ToBytes(weights));
+
+    // a zero bias stays zero
+    if (!has_bias) {
+      return true;
+    }
+  }
+
+  int bias_index = BiasTensor(op, channels);
+
+  for (int c = 0; c < channels; c++) {
+    bias[c] = is_mul ? bias[c] * values[c] : bias[c] + values[c];
+  }
+
+  SetTensorData(bias_index, ToBytes(bias));
+  return true;
+}
+
+bool AffineFolding::FoldQuantized(Operator& op, bool is_mul,
+    const std::vector<float>& values) {
+  std::vector<Tensor>& tensors = model_.graph().Tensors();
+  int filter_index = op.inputs()[1];
+  bool has_bias = op.inputs().size() > 2 && op.inputs()[2] >= 0;
+
+  if (NumConsumers(filter_index) != 1 ||
+      (has_bias && NumConsumers(op.inputs()[2]) != 1) ||
+      !IsQuantized(tensors[op.inputs()[0]]) ||
+      !IsQuantized(tensors[filter_index]) ||
+      tensors[filter_index].quantization().scale.size() != 1) {
+    return false;
+  }
+
+  if (is_mul) {
+    // only a positive scalar can go to the scale of the filter
+    float scale = values[0];
+    bool uniform = std::all_of(values.begin(), values.end(),
+        [scale](float v) { return v == scale; });
+
+    if (!uniform || scale <= 0) {
+      return false;
+    }
+
+    QuantizationParameters& filter_quant = tensors[filter_index].quantization();
+    filter_quant.scale[0] *= scale;
+
+    for (auto& v : filter_quant.min) {
+      v *= scale;
+    }
+
+    for (auto& v : filter_quant.max) {
+      v *= scale;
+    }
+
+    if (has_bias) {
+      tensors[op.inputs()[2]].quantization().scale[0] *= scale;
+    }
+
+    return true;
+  }
+
+  int channels = values.size();
+  int bias_index = BiasTensor(op, channels);
+  const Tensor& bias_tensor = model_.graph().Tensors()[bias_index];
+
+  if (bias_tensor.tensor_type() != TensorType::INT32 ||
+      !IsQuantized(bias_tensor)) {
+    return false;
+  }
+
+  std::vector<int32_t> bias = ReadBuffer<int32_t>(bias_tensor.buffer());
+  float bias_scale = bias_tensor.quantization().scale[0];
+
+  if (static_cast<int>(bias.size()) != channels) {
+    return false;
+  }
+
+  for (int c = 0; c < channels; c++) {
+    bias[c] += static_cast<int32_t>(std::round(values[c] / bias_scale));
+  }
+
+  SetTensorData(bias_index, ToBytes(bias));
+  return true;
+}
+
+bool AffineFolding::Fold(Operator& op, Operator& elementwise) {
+  BuiltinOperator code = elementwise.op_code().builtin_code;
+  if ((code != BuiltinOperator::MUL && code != BuiltinOperator::ADD) ||
+      elementwise.inputs().size() != 2 || elementwise.outputs().size() != 1) {
+    return false;
+  }
+
+  // an activation between the operators would make it non linear
+  ActivationFunctionType* activation = FusedActivation(op);
+  if (activation == nullptr || *activation != ActivationFunctionType::NONE) {
+    return false;
+  }
+
+  Graph& graph = model_.graph();
+  int output = op.outputs()[0];
+  int constant = elementwise.inputs()[0] == output ?
+      elementwise.inputs()[1] : elementwise.inputs()[0];
+  int new_output = elementwise.outputs()[0];
+
+  if (constant < 0 || constant == output ||
+      graph.Tensors()[constant].buffer().Empty()) {
+    return false;
+  }
+
+  // the elementwise operator can't broadcast the output to a bigger shape
+  const Tensor& out_tensor = graph.Tensors()[output];
+  const Tensor& new_tensor = graph.Tensors()[new_output];
+  if (out_tensor.shape() != new_tensor.shape() ||
+      out_tensor.tensor_type() != new_tensor.tensor_type() ||
+      out_tensor.shape().empty()) {
+    return false;
+  }
+
+  int channels = out_tensor.shape().back();
+  std::vector<float> values;
+  if (!ChannelValues(graph.Tensors()[constant], channels, values)) {
+    return false;
+  }
+
+  const Tensor& filter = graph.Tensors()[op.inputs()[1]];
+  bool is_mul = code == BuiltinOperator::MUL;
+  bool folded;
+
+  if (filter.tensor_type() == TensorType::FLOAT32) {
+    folded = FoldFloat(op, is_mul, values);
+  } else if (filter.tensor_type() == TensorType::UINT8) {
+    // the output multiplier in_scale * filter_scale / out_scale must stay
+    // below 1, as NNAPI requires
+    const Tensor& input = graph.Tensors()[op.inputs()[0]];
+    if (!IsQuantized(new_tensor) || !IsQuantized(filter) ||
+        !IsQuantized(input)) {
+      return false;
+    }
+
+    float filter_scale = filter.quantization().scale[0] *
+        (is_mul ? values[0] : 1.0f);
+
+    if (input.quantization().scale[0] * filter_scale >=
+        new_tensor.quantization().scale[0]) {
+      return false;
+    }
+
+    folded = FoldQuantized(op, is_mul, values);
+  } else {
+    return false;
+  }
+
+  if (!folded) {
+    return false;
+  }
+
+  ActivationFunctionType* elementwise_activation =
+      FusedActivation(elementwise);
+  *activation = elementwise_activation ?
+      *elementwise_activation : ActivationFunctionType::NONE;
+
+  op.SetOutputs(std::vector<int>{new_output});
+  return true;
+}
+
+int AffineFolding::Run() {
+  Graph& graph = model_.graph();
+  std::vector<Operator>& operators = graph.Operators();
+
+  std::vector<bool> removed(operators.size(), false);
+  int count = 0;
+
+  for (auto& op : operators) {
+    BuiltinOperator code = op.op_code().builtin_code;
+    if ((code != BuiltinOperator::CONV_2D &&
+        code != BuiltinOperator::DEPTHWISE_CONV_2D &&
+        code != BuiltinOperator::FULLY_CONNECTED) ||
+        op.inputs().size() < 2 || op.outputs().size() != 1 ||
+        graph.Tensors()[op.inputs()[1]].buffer().Empty()) {
+      continue;
+    }
+
+    // a MUL followed by an ADD are folded one after the other, the
+    // operator takes the output of the folded one, whose readers are still
+    // the ones on the index
+    while (true) {
+      int output = op.outputs()[0];
+
+      if (index_.NumConsumers(output) != 1 || index_.IsGraphOutput(output)) {
+        break;
+      }
+
+      int next = index_.FirstConsumer(output);
+      if (removed[next] || !Fold(op, operators[next])) {
+        break;
+      }
+
+      removed[next] = true;
+      ++count;
+    }
+  }
+
+  graph.RemoveOperators(removed);
+  return count;
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef NNT_AFFINE_FOLDING_H
+#define NNT_AFFINE_FOLDING_H
+
+#include <vector>
+
+#include "model.h"
+#include "graph-index.h"
+
+namespace nnt {
+
+// Folds a MUL by a constant and an ADD of a constant that follow a
+// CONV_2D, DEPTHWISE_CONV_2D or FULLY_CONNECTED into the weights and the
+// bias of that operator, like the batch normalization left by some
+// converters. The constants must be a scalar or have one value per output
+// channel. Float weights are rescaled on new buffers of the model. On
+// quantized models a positive scalar MUL changes the scale of the filter
+// and of the bias, and an ADD is added to the int32 bias, when the new
+// scales are still valid.
+class AffineFolding {
+ public:
+  AffineFolding(Model& model, const GraphIndex& index)
+    : model_(model)
+    , index_(index) {}
+
+  // returns the number of elementwise operators folded
+  int Run();
+
+ private:
+  // folds the elementwise operator that reads the output of op, returns
+  // false if the pattern doesn't match, in this case nothing changes
+  bool Fold(Operator& op, Operator& elementwise);
+
+  bool FoldFloat(Operator& op, bool is_mul, const std::vector<float>& values);
+  bool FoldQuantized(Operator& op, bool is_mul,
+      const std::vector<float>& values);
+
+  // values of the constant operand, one per output channel
+  bool ChannelValues(const Tensor& constant, int channels,
+      std::vector<float>& values);
+
+  // index of the bias of the operator, a zero bias is created if the
+  // operator has none
+  int BiasTensor(Operator& op, int channels);
+
+  void SetTensorData(int index, std::vector<u_char>&& data);
+
+  // readers of the tensor, the bias tensors created by the pass are not on
+  // the index and have a single reader
+  int NumConsumers(int tensor) const {
+    return tensor < index_.NumTensors() ? index_.NumConsumers(tensor) : 1;
+  }
+
+  Model& model_;
+  const GraphIndex& index_;
+};
+
+}
+
+#endif  // NNT_AFFINE_FOLDING_H
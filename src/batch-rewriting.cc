@@ -0,0 +1,116 @@
+#include "batch-rewriting.h"
+
+#include <cstring>
+#include <boost/format.hpp>
+
+#include "exception.h"
+#include "shape-inference.h"
+
+namespace nnt {
+
+bool BatchRewriting::RewriteReshape(Operator& op, int old_batch,
+    std::vector<bool>& rewritten) {
+  std::vector<Tensor>& tensors = model_.graph().Tensors();
+  bool changed = false;
+
+  if (op.builtin_op().type == BuiltinOptionsType::ReshapeOptions) {
+    std::vector<int>& new_shape =
+        static_cast<ReshapeOptions&>(op.builtin_op()).new_shape;
+
+    if (!new_shape.empty() && new_shape[0] == old_batch) {
+      new_shape[0] = batch_;
+      changed = true;
+    }
+  }
+
+  // the shape input is what NNAPI reads, it may be shared by other
+  // reshapes, so it is only rewritten once
+  if (op.inputs().size() < 2 || op.inputs()[1] < 0) {
+    return changed;
+  }
+
+  int shape_index = op.inputs()[1];
+  Tensor& shape_tensor = tensors[shape_index];
+  const Buffer& buffer = shape_tensor.buffer();
+
+  if (rewritten[shape_index] || buffer.Empty() ||
+      shape_tensor.tensor_type() != TensorType::INT32 ||
+      buffer.Size() < sizeof(int32_t)) {
+    return changed;
+  }
+
+  std::vector<u_char> data(buffer.begin(), buffer.end());
+  int32_t first;
+  std::memcpy(&first, data.data(), sizeof(first));
+
+  if (first != old_batch) {
+    return changed;
+  }
+
+  first = batch_;
+  std::memcpy(data.data(), &first, sizeof(first));
+
+  uint buffer_index = model_.AddBuffer(std::move(data));
+  shape_tensor.SetBuffer(model_.Buffers()[buffer_index], buffer_index);
+  rewritten[shape_index] = true;
+
+  return true;
+}
+
+int BatchRewriting::Run() {
+  Graph& graph = model_.graph();
+  std::vector<Tensor>& tensors = graph.Tensors();
+
+  if (batch_ <= 0) {
+    FATAL(boost::format("Batch size must be positive, got %1%")%batch_)
+  }
+
+  if (const Operator* op = ShapeInference(graph).FixedOperator()) {
+    FATAL(boost::format("Batch can't be changed, the shapes of operator %1% "
+        "with %2% are not computed again")%op->index()%op->builtin_op_str())
+  }
+
+  // the batch of the file, the reshapes that start with it are rewritten
+  int old_batch = 0;
+  int count = 0;
+
+  for (int i : graph.Inputs()) {
+    std::vector<int> shape = tensors[i].shape();
+
+    if (shape.empty()) {
+      continue;
+    }
+
+    if (old_batch == 0) {
+      old_batch = shape[0] > 0 ? shape[0] : 1;
+    }
+
+    shape[0] = batch_;
+    tensors[i].SetShape(std::move(shape));
+    ++count;
+  }
+
+  std::vector<bool> rewritten(tensors.size(), false);
+
+  for (auto& op : graph.Operators()) {
+    for (int i : op.outputs()) {
+      std::vector<int> shape = tensors[i].shape();
+
+      if (!shape.empty()) {
+        shape[0] = -1;
+        tensors[i].SetShape(std::move(shape));
+      }
+    }
+
+    if (op.op_code().builtin_code == BuiltinOperator::RESHAPE &&
+        !op.inputs().empty() && op.inputs()[0] >= 0 &&
+        tensors[op.inputs()[0]].buffer().Empty() &&
+        RewriteReshape(op, old_batch, rewritten)) {
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef NNT_BATCH_REWRITING_H
+#define NNT_BATCH_REWRITING_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Changes the batch size of the model: the leading dimension of the graph
+// inputs is set to the new batch, and the leading dimension of every
+// tensor written by an operator is left unknown, so the shape inference
+// computes it again. A RESHAPE whose new shape starts with the batch of the
+// file gets the new batch, on its options and on its constant shape input.
+// Operators that take the batch from other constants, like a STRIDED_SLICE
+// with an explicit end on the first dimension, are not rewritten, and models
+// with operators whose shapes are not inferred, like the recurrent ones, are
+// rejected.
+class BatchRewriting {
+ public:
+  BatchRewriting(Model& model, int batch): model_(model), batch_(batch) {}
+
+  // returns the number of inputs and reshapes rewritten
+  int Run();
+
+ private:
+  // rewrites the new shape of the reshape if it starts with the old batch
+  bool RewriteReshape(Operator& op, int old_batch,
+      std::vector<bool>& rewritten);
+
+  Model& model_;
+  int batch_;
+};
+
+}
+
+#endif  // NNT_BATCH_REWRITING_H
@@ -0,0 +1,133 @@
+#include "call-inlining.h"
+
+#include <boost/format.hpp>
+
+#include "exception.h"
+
+namespace nnt {
+
+void CallInlining::Inline(const Operator& call,
+    std::vector<Operator>& operators) {
+  Graph& graph = model_.graph();
+
+  if (call.builtin_op().type != BuiltinOptionsType::CallOptions) {
+    FATAL("CALL operator without CallOptions")
+  }
+
+  uint subgraph = static_cast<const CallOptions&>(call.builtin_op()).subgraph;
+
+  if (subgraph == 0 || subgraph >= model_.NumGraphs()) {
+    FATAL(boost::format("CALL of subgraph %1%, the model has %2% subgraphs")
+        %subgraph%model_.NumGraphs())
+  }
+
+  const Graph& callee = model_.graph(subgraph);
+
+  if (call.inputs().size() != callee.Inputs().size() ||
+      call.outputs().size() != callee.Outputs().size()) {
+    FATAL(boost::format("CALL with %1% inputs and %2% outputs, subgraph %3% "
+        "has %4% inputs and %5% outputs")%call.inputs().size()
+        %call.outputs().size()%subgraph%callee.Inputs().size()
+        %callee.Outputs().size())
+  }
+
+  // tensor of the subgraph -> tensor of the main graph
+  std::vector<int> tensor_map(callee.Tensors().size(), -1);
+
+  for (size_t i = 0; i < callee.Inputs().size(); i++) {
+    tensor_map[callee.Inputs()[i]] = call.inputs()[i];
+  }
+
+  // an output must be written by an operator of the subgraph, so the
+  // output of the CALL still has a producer
+  std::vector<bool> written(callee.Tensors().size(), false);
+  for (const auto& op : callee.Operators()) {
+    for (int i : op.outputs()) {
+      written[i] = true;
+    }
+  }
+
+  for (size_t i = 0; i < callee.Outputs().size(); i++) {
+    int output = callee.Outputs()[i];
+
+    if (!written[output] || tensor_map[output] >= 0) {
+      FATAL(boost::format("Output %1% of subgraph %2% is not computed by "
+          "the subgraph")%callee.Tensors()[output].name()%subgraph)
+    }
+
+    tensor_map[output] = call.outputs()[i];
+  }
+
+  // the other tensors are copied when an operator uses them, optional
+  // inputs keep the -1 index
+  auto map_tensor = [&](int i) {
+    if (i < 0) {
+      return i;
+    }
+
+    if (tensor_map[i] < 0) {
+      const Tensor& tensor = callee.Tensors()[i];
+      std::unique_ptr<QuantizationParameters> quantization;
+
+      if (tensor.HasQuantization()) {
+        quantization = std::make_unique<QuantizationParameters>(
+            tensor.quantization());
+      }
+
+      graph.AddTensor(Tensor(std::vector<int>(tensor.shape()),
+          tensor.tensor_type(), tensor.name(), tensor.buffer(),
+          tensor.buffer_index(), std::move(quantization)));
+      tensor_map[i] = graph.Tensors().size() - 1;
+    }
+
+    return tensor_map[i];
+  };
+
+  for (const auto& op : callee.Operators()) {
+    std::vector<int> inputs;
+    for (int i : op.inputs()) {
+      inputs.push_back(map_tensor(i));
+    }
+
+    std::vector<int> outputs;
+    for (int i : op.outputs()) {
+      outputs.push_back(map_tensor(i));
+    }
+
+    operators.push_back(Operator(op.index(), op.op_code(),
+        CloneBuiltinOptions(op.builtin_op()), op.builtin_op_str(),
+        std::move(inputs), std::move(outputs)));
+  }
+}
+
+int CallInlining::Run() {
+  Graph& graph = model_.graph();
+  int count = 0;
+
+  // each round inlines one level of calls, without recursion no chain of
+  // calls is deeper than the number of subgraphs
+  for (size_t round = 0; round < model_.NumGraphs(); round++) {
+    std::vector<Operator> operators;
+    bool inlined = false;
+
+    for (auto& op : graph.Operators()) {
+      if (op.op_code().builtin_code == BuiltinOperator::CALL) {
+        Inline(op, operators);
+        inlined = true;
+        ++count;
+      } else {
+        operators.push_back(std::move(op));
+      }
+    }
+
+    graph.Operators() = std::move(operators);
+
+    if (!inlined) {
+      return count;
+    }
+  }
+
+  FATAL("CALL operators are recursive")
+}
+
+}
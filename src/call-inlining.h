@@ -0,0 +1,32 @@
+#ifndef NNT_CALL_INLINING_H
+#define NNT_CALL_INLINING_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Replaces the CALL operators of the main graph by the operators of the
+// subgraphs they call. The tensors of the subgraph are copied to the main
+// graph, except its inputs and outputs, which are bound to the inputs and
+// outputs of the CALL, so the flat graph is optimized and scheduled as a
+// whole. Calls inside the called subgraphs are inlined as well, recursive
+// calls are an error.
+class CallInlining {
+ public:
+  CallInlining(Model& model): model_(model) {}
+
+  // returns the number of calls inlined
+  int Run();
+
+ private:
+  // appends the operators of the subgraph called by the operator
+  void Inline(const Operator& call, std::vector<Operator>& operators);
+
+  Model& model_;
+};
+
+}
+
+#endif  // NNT_CALL_INLINING_H
@@ -0,0 +1,190 @@
+#include "common-subexpression-elimination.h"
+
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
+
+namespace nnt {
+
+// true if the tensors hold values of the same kind, so one can stand for
+// the other
+static bool SameTensorInfo(const Tensor& a, const Tensor& b) {
+  if (a.tensor_type() != b.tensor_type() || a.shape() != b.shape() ||
+      a.HasQuantization() != b.HasQuantization()) {
+    return false;
+  }
+
+  if (!a.HasQuantization()) {
+    return true;
+  }
+
+  return a.quantization().scale == b.quantization().scale &&
+      a.quantization().zero_point == b.quantization().zero_point &&
+      a.quantization().quantized_dimension ==
+      b.quantization().quantized_dimension;
+}
+
+int CommonSubexpressionElimination::MergeConstants(
+    std::vector<int>& replacement) {
+  const std::vector<Tensor>& tensors = graph_.Tensors();
+  std::unordered_map<uint, std::vector<int>> by_buffer;
+  int count = 0;
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    if (tensors[i].buffer().Empty()) {
+      continue;
+    }
+
+    std::vector<int>& same_buffer = by_buffer[tensors[i].buffer_index()];
+    bool merged = false;
+
+    for (int other : same_buffer) {
+      if (SameTensorInfo(tensors[i], tensors[other])) {
+        replacement[i] = other;
+        merged = true;
+        ++count;
+        break;
+      }
+    }
+
+    if (!merged) {
+      same_buffer.push_back(i);
+    }
+  }
+
+  return count;
+}
+
+bool CommonSubexpressionElimination::CanMerge(const Operator& op) {
+  switch (op.op_code().builtin_code) {
+    // the recurrent operators keep state between executions, and nothing
+    // is known about custom operators
+    case BuiltinOperator::CUSTOM:
+    case BuiltinOperator::CALL:
+    case BuiltinOperator::DELEGATE:
+    case BuiltinOperator::LSTM:
+    case BuiltinOperator::RNN:
+    case BuiltinOperator::SVDF:
+    case BuiltinOperator::UNIDIRECTIONAL_SEQUENCE_RNN:
+    case BuiltinOperator::UNIDIRECTIONAL_SEQUENCE_LSTM:
+    case BuiltinOperator::BIDIRECTIONAL_SEQUENCE_RNN:
+    case BuiltinOperator::BIDIRECTIONAL_SEQUENCE_LSTM:
+      return false;
+
+    default:
+      break;
+  }
+
+  // options of a type the model doesn't read can't be compared
+  if (op.builtin_op().type == BuiltinOptionsType::None &&
+      op.builtin_op_str() != "NONE") {
+    return false;
+  }
+
+  if (op.outputs().empty()) {
+    return false;
+  }
+
+  for (int i : op.outputs()) {
+    if (index_.IsGraphOutput(i)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool CommonSubexpressionElimination::SameOperator(const Operator& a,
+    const Operator& b) {
+  if (a.op_code().builtin_code != b.op_code().builtin_code ||
+      a.op_code().custom_code != b.op_code().custom_code ||
+      a.inputs() != b.inputs() ||
+      a.outputs().size() != b.outputs().size() ||
+      !BuiltinOptionsEqual(a.builtin_op(), b.builtin_op())) {
+    return false;
+  }
+
+  // quantized outputs with other scales hold other values
+  const std::vector<Tensor>& tensors = graph_.Tensors();
+  for (size_t i = 0; i < a.outputs().size(); i++) {
+    if (!SameTensorInfo(tensors[a.outputs()[i]], tensors[b.outputs()[i]])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t CommonSubexpressionElimination::Hash(const Operator& op) {
+  size_t seed = static_cast<size_t>(op.op_code().builtin_code);
+
+  boost::hash_combine(seed, op.op_code().custom_code);
+  boost::hash_combine(seed, BuiltinOptionsHash(op.builtin_op()));
+  boost::hash_combine(seed, op.inputs());
+
+  return seed;
+}
+
+int CommonSubexpressionElimination::Run() {
+  std::vector<Operator>& operators = graph_.Operators();
+  std::vector<int> replacement(graph_.Tensors().size());
+
+  for (size_t i = 0; i < replacement.size(); i++) {
+    replacement[i] = i;
+  }
+
+  int count = MergeConstants(replacement);
+
+  // operators are on topological order, so the inputs of an operator are
+  // already replaced when it is visited
+  std::unordered_multimap<size_t, int> seen;
+  std::vector<bool> removed(operators.size(), false);
+
+  for (size_t op = 0; op < operators.size(); op++) {
+    std::vector<int> inputs = operators[op].inputs();
+    bool changed = false;
+
+    for (int& i : inputs) {
+      if (i >= 0 && replacement[i] != i) {
+        i = replacement[i];
+        changed = true;
+      }
+    }
+
+    if (changed) {
+      operators[op].SetInputs(std::move(inputs));
+    }
+
+    if (!CanMerge(operators[op])) {
+      continue;
+    }
+
+    size_t hash = Hash(operators[op]);
+    auto range = seen.equal_range(hash);
+    int match = -1;
+
+    for (auto it = range.first; it != range.second; ++it) {
+      if (SameOperator(operators[it->second], operators[op])) {
+        match = it->second;
+        break;
+      }
+    }
+
+    if (match < 0) {
+      seen.emplace(hash, op);
+      continue;
+    }
+
+    const std::vector<int>& outputs = operators[op].outputs();
+    for (size_t i = 0; i < outputs.size(); i++) {
+      replacement[outputs[i]] = operators[match].outputs()[i];
+    }
+
+    removed[op] = true;
+    ++count;
+  }
+
+  graph_.RemoveOperators(removed);
+  return count;
+}
+
+}
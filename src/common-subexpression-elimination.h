@@ -0,0 +1,43 @@
+#ifndef NNT_COMMON_SUBEXPRESSION_ELIMINATION_H
+#define NNT_COMMON_SUBEXPRESSION_ELIMINATION_H
+
+#include <vector>
+
+#include "model.h"
+#include "graph-index.h"
+
+namespace nnt {
+
+// Merges the operators that compute the same thing: the same operator code,
+// equal options and the same input tensors. The readers of a duplicated
+// operator read the outputs of the first one and the duplicated operator is
+// removed, its outputs are left to the dead code elimination. Constant
+// tensors on the same buffer, with the same type, shape and quantization,
+// count as the same input. Custom and recurrent operators, and the ones
+// that write graph outputs, are never merged.
+class CommonSubexpressionElimination {
+ public:
+  CommonSubexpressionElimination(Graph& graph, const GraphIndex& index)
+    : graph_(graph)
+    , index_(index) {}
+
+  // returns the number of operators and constant tensors merged
+  int Run();
+
+ private:
+  // constant tensors that duplicate another one are replaced by it
+  int MergeConstants(std::vector<int>& replacement);
+
+  bool CanMerge(const Operator& op);
+
+  bool SameOperator(const Operator& a, const Operator& b);
+
+  size_t Hash(const Operator& op);
+
+  Graph& graph_;
+  const GraphIndex& index_;
+};
+
+}
+
+#endif  // NNT_COMMON_SUBEXPRESSION_ELIMINATION_H
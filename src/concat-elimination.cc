@@ -0,0 +1,117 @@
+#include "concat-elimination.h"
+
+#include <algorithm>
+
+namespace nnt {
+
+void AddConcatAliases(const Graph& graph, std::vector<TensorAlias>& aliases) {
+  const std::vector<Tensor>& tensors = graph.Tensors();
+  const std::vector<int>& inputs = graph.Inputs();
+  const std::vector<int>& outputs = graph.Outputs();
+
+  std::vector<bool> produced(tensors.size(), false);
+  std::vector<int> consumers(tensors.size(), 0);
+
+  for (const auto& op : graph.Operators()) {
+    for (int i : op.outputs()) {
+      produced[i] = true;
+    }
+
+    for (int i : op.inputs()) {
+      if (i >= 0) {
+        consumers[i]++;
+      }
+    }
+  }
+
+  auto contains = [](const std::vector<int>& vec, int index) {
+    return std::find(vec.begin(), vec.end(), index) != vec.end();
+  };
+
+  for (const auto& op : graph.Operators()) {
+    if (op.op_code().builtin_code != BuiltinOperator::CONCATENATION ||
+        op.builtin_op().type != BuiltinOptionsType::ConcatenationOptions ||
+        op.outputs().size() != 1) {
+      continue;
+    }
+
+    const ConcatenationOptions& options =
+        static_cast<const ConcatenationOptions&>(op.builtin_op());
+
+    // the activation would have to run over the inputs after they are
+    // written
+    if (options.fused_activation_function != ActivationFunctionType::NONE) {
+      continue;
+    }
+
+    int output = op.outputs()[0];
+    const Tensor& out_tensor = tensors[output];
+    const std::vector<int>& shape = out_tensor.shape();
+    int axis = options.axis < 0 ? options.axis + shape.size() : options.axis;
+
+    if (!out_tensor.buffer().Empty() || axis < 0 ||
+        axis >= static_cast<int>(shape.size())) {
+      continue;
+    }
+
+    // the slices are contiguous only if every dimension before the axis is 1
+    bool outermost = std::all_of(shape.begin(), shape.begin() + axis,
+        [](int dim) { return dim == 1; });
+
+    if (!outermost) {
+      continue;
+    }
+
+    // the input must be written by an operator and read only by this one,
+    // graph inputs and outputs have their own storage
+    bool eligible = std::all_of(op.inputs().begin(), op.inputs().end(),
+        [&](int i) {
+          return i >= 0 && tensors[i].buffer().Empty() && produced[i] &&
+              consumers[i] == 1 && aliases[i].tensor < 0 &&
+              tensors[i].tensor_type() == out_tensor.tensor_type() &&
+              !contains(inputs, i) && !contains(outputs, i);
+        });
+
+    if (!eligible) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (int i : op.inputs()) {
+      aliases[i] = TensorAlias{output, offset};
+      offset += TensorByteSize(tensors[i]);
+    }
+  }
+
+  // resolve the chains, so every alias points to a tensor that owns its
+  // storage
+  std::vector<TensorAlias> resolved(aliases.size());
+  for (size_t i = 0; i < aliases.size(); i++) {
+    int tensor = i;
+    size_t offset = 0;
+
+    while (aliases[tensor].tensor >= 0) {
+      offset += aliases[tensor].offset;
+      tensor = aliases[tensor].tensor;
+    }
+
+    if (tensor != static_cast<int>(i)) {
+      resolved[i] = TensorAlias{tensor, offset};
+    }
+  }
+
+  aliases = std::move(resolved);
+}
+
+bool ConcatOnPlace(const Operator& op,
+    const std::vector<TensorAlias>& aliases) {
+  int output = op.outputs()[0];
+  int root = aliases[output].tensor >= 0 ? aliases[output].tensor : output;
+
+  return std::all_of(op.inputs().begin(), op.inputs().end(),
+      [&aliases, root](int i) {
+        return i >= 0 && aliases[i].tensor == root;
+      });
+}
+
+}
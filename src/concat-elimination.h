@@ -0,0 +1,27 @@
+#ifndef NNT_CONCAT_ELIMINATION_H
+#define NNT_CONCAT_ELIMINATION_H
+
+#include <vector>
+
+#include "model.h"
+#include "memory-planner.h"
+
+namespace nnt {
+
+// When a CONCATENATION joins its inputs on the outermost axis with more than
+// one element, every input is a contiguous slice of the output. If the
+// input is only read by the concatenation, the operator that produces it
+// can write straight on its slice of the output, the input becomes an alias
+// of the output at the slice offset and the concatenation doesn't copy
+// anything. The aliases are added to the ones already on the vector, and
+// chains, e.g. nested concatenations, are resolved to the final storage.
+void AddConcatAliases(const Graph& graph, std::vector<TensorAlias>& aliases);
+
+// true if all inputs of the CONCATENATION are already on place in the
+// output, so the operator doesn't need to run
+bool ConcatOnPlace(const Operator& op,
+    const std::vector<TensorAlias>& aliases);
+
+}
+
+#endif  // NNT_CONCAT_ELIMINATION_H
@@ -0,0 +1,586 @@
+#include "constant-folding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace nnt {
+
+static bool IsQuantized(const Tensor& tensor) {
+  return tensor.HasQuantization() && !tensor.quantization().scale.empty();
+}
+
+template<class T>
+static void ReadAs(const Buffer& buffer, std::vector<double>& values) {
+  std::vector<T> data = ReadBuffer<T>(buffer);
+  values.assign(data.begin(), data.end());
+}
+
+// integers are truncated toward zero and wrap to the size of the type, like
+// the casts of the runtime, values out of the range of int64 and nan are not
+// written
+template<class T>
+static bool WriteAs(const std::vector<double>& values,
+    std::vector<u_char>& data) {
+  const double int64_limit = 9223372036854775808.0;
+  data.resize(values.size() * sizeof(T));
+
+  for (size_t i = 0; i < values.size(); i++) {
+    T value;
+
+    if (std::is_integral<T>::value) {
+      if (!(values[i] >= -int64_limit && values[i] < int64_limit)) {
+        return false;
+      }
+
+      value = static_cast<T>(static_cast<int64_t>(values[i]));
+    } else {
+      value = static_cast<T>(values[i]);
+    }
+
+    std::memcpy(data.data() + i * sizeof(T), &value, sizeof(T));
+  }
+
+  return true;
+}
+
+// reads the elements of a constant tensor of a numeric type
+static bool ReadValues(const Tensor& tensor, std::vector<double>& values) {
+  switch (tensor.tensor_type()) {
+    case TensorType::FLOAT32:
+      ReadAs<float>(tensor.buffer(), values);
+      return true;
+
+    case TensorType::INT32:
+      ReadAs<int32_t>(tensor.buffer(), values);
+      return true;
+
+    case TensorType::INT64:
+      ReadAs<int64_t>(tensor.buffer(), values);
+      return true;
+
+    case TensorType::UINT8:
+      ReadAs<uint8_t>(tensor.buffer(), values);
+      return true;
+
+    case TensorType::INT8:
+      ReadAs<int8_t>(tensor.buffer(), values);
+      return true;
+
+    case TensorType::FLOAT16: {
+      ReadAs<uint16_t>(tensor.buffer(), values);
+
+      for (auto& value : values) {
+        value = HalfToFloat(static_cast<uint16_t>(value));
+      }
+
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+static bool WriteValues(const std::vector<double>& values, TensorType type,
+    std::vector<u_char>& data) {
+  switch (type) {
+    case TensorType::FLOAT32:
+      return WriteAs<float>(values, data);
+
+    case TensorType::INT32:
+      return WriteAs<int32_t>(values, data);
+
+    case TensorType::INT64:
+      return WriteAs<int64_t>(values, data);
+
+    case TensorType::UINT8:
+      return WriteAs<uint8_t>(values, data);
+
+    case TensorType::INT8:
+      return WriteAs<int8_t>(values, data);
+
+    default:
+      return false;
+  }
+}
+
+static double Activate(double value, ActivationFunctionType activation) {
+  switch (activation) {
+    case ActivationFunctionType::RELU:
+      return std::max(value, 0.0);
+
+    case ActivationFunctionType::RELU1:
+      return std::min(std::max(value, -1.0), 1.0);
+
+    case ActivationFunctionType::RELU6:
+      return std::min(std::max(value, 0.0), 6.0);
+
+    case ActivationFunctionType::TANH:
+      return std::tanh(value);
+
+    default:
+      return value;
+  }
+}
+
+const Tensor& ConstantFolding::GetTensor(int index) {
+  return model_.graph().Tensors()[index];
+}
+
+bool ConstantFolding::IsConstant(int index) {
+  return index >= 0 && !GetTensor(index).buffer().Empty();
+}
+
+bool ConstantFolding::FoldCopy(const Operator& op,
+    std::vector<u_char>& result) {
+  const Tensor& input = GetTensor(op.inputs()[0]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+
+  // reshape and squeeze only change the shape, the data stays the same
+  if (input.tensor_type() != output.tensor_type() ||
+      input.buffer().Size() != TensorByteSize(output)) {
+    return false;
+  }
+
+  result.assign(input.buffer().begin(), input.buffer().end());
+  return true;
+}
+
+bool ConstantFolding::FoldTranspose(const Operator& op,
+    std::vector<u_char>& result) {
+  if (op.inputs().size() != 2) {
+    return false;
+  }
+
+  const Tensor& input = GetTensor(op.inputs()[0]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+  const std::vector<int>& in_shape = input.shape();
+  const std::vector<int>& out_shape = output.shape();
+
+  std::vector<double> perm;
+  if (!ReadValues(GetTensor(op.inputs()[1]), perm) ||
+      perm.size() != in_shape.size() || out_shape.size() != in_shape.size() ||
+      input.tensor_type() != output.tensor_type() ||
+      input.buffer().Size() != TensorByteSize(output)) {
+    return false;
+  }
+
+  int rank = in_shape.size();
+  size_t elem_size = TensorTypeSize(input.tensor_type());
+
+  // negative axes count from the end, as on the shape inference, and each
+  // axis must appear once
+  std::vector<int> axes(rank);
+  std::vector<bool> seen(rank, false);
+
+  for (int i = 0; i < rank; i++) {
+    int axis = static_cast<int>(perm[i]);
+    axes[i] = axis < 0 ? axis + rank : axis;
+
+    if (axes[i] < 0 || axes[i] >= rank || seen[axes[i]]) {
+      return false;
+    }
+
+    seen[axes[i]] = true;
+  }
+
+  // strides of the input, in elements
+  std::vector<size_t> in_strides(rank, 1);
+  for (int i = rank - 2; i >= 0; i--) {
+    in_strides[i] = in_strides[i + 1] * in_shape[i + 1];
+  }
+
+  result.resize(input.buffer().Size());
+  std::vector<int> coord(rank, 0);
+  size_t count = NumElements(out_shape);
+
+  for (size_t out = 0; out < count; out++) {
+    // output dimension i walks the input dimension axes[i]
+    size_t in = 0;
+    for (int i = 0; i < rank; i++) {
+      in += coord[i] * in_strides[axes[i]];
+    }
+
+    std::memcpy(result.data() + out * elem_size,
+        input.buffer().RawData() + in * elem_size, elem_size);
+
+    for (int i = rank - 1; i >= 0; i--) {
+      if (++coord[i] < out_shape[i]) {
+        break;
+      }
+
+      coord[i] = 0;
+    }
+  }
+
+  return true;
+}
+
+bool ConstantFolding::FoldDequantize(const Operator& op,
+    std::vector<u_char>& result) {
+  const Tensor& input = GetTensor(op.inputs()[0]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+
+  if (output.tensor_type() != TensorType::FLOAT32) {
+    return false;
+  }
+
+  std::vector<double> values;
+  if (!ReadValues(input, values)) {
+    return false;
+  }
+
+  // the fp16 weights of a float model are dequantized by widening them
+  if (input.tensor_type() == TensorType::FLOAT16) {
+    return WriteValues(values, TensorType::FLOAT32, result);
+  }
+
+  if (!IsQuantized(input)) {
+    return false;
+  }
+
+  const QuantizationParameters& quant = input.quantization();
+
+  // a per-tensor input is a single channel, the channel of an element of a
+  // per-channel input is its index along the quantized dimension
+  size_t channels = 1;
+  size_t inner = 1;
+
+  if (quant.PerChannel()) {
+    const std::vector<int>& shape = input.shape();
+    int dim = quant.quantized_dimension;
+
+    channels = shape[dim];
+    inner = NumElements(std::vector<int>(shape.begin() + dim + 1,
+        shape.end()));
+  }
+
+  for (size_t i = 0; i < values.size(); i++) {
+    size_t channel = (i / inner) % channels;
+    double scale = quant.scale[channel];
+    double zero_point = quant.zero_point.empty() ? 0 :
+        quant.zero_point[quant.zero_point.size() > 1 ? channel : 0];
+
+    values[i] = (values[i] - zero_point) * scale;
+  }
+
+  return WriteValues(values, TensorType::FLOAT32, result);
+}
+
+bool ConstantFolding::FoldCast(const Operator& op,
+    std::vector<u_char>& result) {
+  const Tensor& input = GetTensor(op.inputs()[0]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+
+  if (IsQuantized(input) || IsQuantized(output)) {
+    return false;
+  }
+
+  std::vector<double> values;
+  if (!ReadValues(input, values)) {
+    return false;
+  }
+
+  // float to integer casts truncate and wrap, see WriteAs
+  return WriteValues(values, output.tensor_type(), result);
+}
+
+bool ConstantFolding::FoldUnary(const Operator& op,
+    std::vector<u_char>& result) {
+  const Tensor& input = GetTensor(op.inputs()[0]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+
+  if (input.tensor_type() != TensorType::FLOAT32 ||
+      output.tensor_type() != TensorType::FLOAT32) {
+    return false;
+  }
+
+  std::vector<double> values;
+  ReadValues(input, values);
+
+  for (auto& value : values) {
+    // compute in float, so the result is the same the runtime gives
+    float x = static_cast<float>(value);
+
+    switch (op.op_code().builtin_code) {
+      case BuiltinOperator::RELU:
+        x = std::max(x, 0.0f);
+        break;
+
+      case BuiltinOperator::RELU1:
+        x = std::min(std::max(x, -1.0f), 1.0f);
+        break;
+
+      case BuiltinOperator::RELU6:
+        x = std::min(std::max(x, 0.0f), 6.0f);
+        break;
+
+      case BuiltinOperator::TANH:
+        x = std::tanh(x);
+        break;
+
+      case BuiltinOperator::LOGISTIC:
+        x = 1.0f / (1.0f + std::exp(-x));
+        break;
+
+      case BuiltinOperator::EXP:
+        x = std::exp(x);
+        break;
+
+      case BuiltinOperator::NEG:
+        x = -x;
+        break;
+
+      default:
+        return false;
+    }
+
+    value = x;
+  }
+
+  return WriteValues(values, TensorType::FLOAT32, result);
+}
+
+bool ConstantFolding::FoldBinary(const Operator& op,
+    std::vector<u_char>& result) {
+  if (op.inputs().size() != 2) {
+    return false;
+  }
+
+  const Tensor& a = GetTensor(op.inputs()[0]);
+  const Tensor& b = GetTensor(op.inputs()[1]);
+  const Tensor& output = GetTensor(op.outputs()[0]);
+  TensorType type = output.tensor_type();
+
+  if (a.tensor_type() != type || b.tensor_type() != type ||
+      (type != TensorType::FLOAT32 && type != TensorType::INT32) ||
+      IsQuantized(output)) {
+    return false;
+  }
+
+  ActivationFunctionType activation = ActivationFunctionType::NONE;
+  const BuiltinOptions& options = op.builtin_op();
+
+  switch (options.type) {
+    case BuiltinOptionsType::AddOptions:
+      activation = static_cast<const AddOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::SubOptions:
+      activation = static_cast<const SubOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::MulOptions:
+      activation = static_cast<const MulOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::DivOptions:
+      activation = static_cast<const DivOptions&>(
+          options).fused_activation_function;
+      break;
+
+    default:
+      break;
+  }
+
+  // shapes are aligned to the right, dimensions of size 1 are broadcast
+  const std::vector<int>& out_shape = output.shape();
+  int rank = out_shape.size();
+
+  auto strides = [rank, &out_shape](const std::vector<int>& shape,
+      std::vector<size_t>& stride) {
+    int offset = rank - shape.size();
+    stride.assign(rank, 0);
+
+    if (offset < 0) {
+      return false;
+    }
+
+    size_t step = 1;
+    for (int i = shape.size() - 1; i >= 0; i--) {
+      if (shape[i] != out_shape[i + offset] && shape[i] != 1) {
+        return false;
+      }
+
+      stride[i + offset] = shape[i] == 1 ? 0 : step;
+      step *= shape[i];
+    }
+
+    return true;
+  };
+
+  std::vector<size_t> a_stride;
+  std::vector<size_t> b_stride;
+  if (!strides(a.shape(), a_stride) || !strides(b.shape(), b_stride)) {
+    return false;
+  }
+
+  std::vector<double> a_values;
+  std::vector<double> b_values;
+  ReadValues(a, a_values);
+  ReadValues(b, b_values);
+
+  if (a_values.size() != NumElements(a.shape()) ||
+      b_values.size() != NumElements(b.shape())) {
+    return false;
+  }
+
+  bool is_float = type == TensorType::FLOAT32;
+  size_t count = NumElements(out_shape);
+  std::vector<double> values(count);
+  std::vector<int> coord(rank, 0);
+
+  for (size_t i = 0; i < count; i++) {
+    size_t ai = 0;
+    size_t bi = 0;
+    for (int d = 0; d < rank; d++) {
+      ai += coord[d] * a_stride[d];
+      bi += coord[d] * b_stride[d];
+    }
+
+    double x = a_values[ai];
+    double y = b_values[bi];
+    double value;
+
+    switch (op.op_code().builtin_code) {
+      case BuiltinOperator::ADD:
+        value = x + y;
+        break;
+
+      case BuiltinOperator::SUB:
+        value = x - y;
+        break;
+
+      case BuiltinOperator::MUL:
+        value = x * y;
+        break;
+
+      case BuiltinOperator::DIV:
+        // integer division by zero is left to the runtime
+        if (!is_float && y == 0) {
+          return false;
+        }
+
+        value = is_float ? x / y : std::trunc(x / y);
+        break;
+
+      case BuiltinOperator::MAXIMUM:
+        value = std::max(x, y);
+        break;
+
+      case BuiltinOperator::MINIMUM:
+        value = std::min(x, y);
+        break;
+
+      default:
+        return false;
+    }
+
+    // round to float before the activation, as the runtime does
+    if (is_float) {
+      value = static_cast<float>(value);
+    }
+
+    values[i] = Activate(value, activation);
+
+    for (int d = rank - 1; d >= 0; d--) {
+      if (++coord[d] < out_shape[d]) {
+        break;
+      }
+
+      coord[d] = 0;
+    }
+  }
+
+  return WriteValues(values, type, result);
+}
+
+bool ConstantFolding::Fold(const Operator& op, std::vector<u_char>& result) {
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::RESHAPE:
+    case BuiltinOperator::SQUEEZE:
+      return FoldCopy(op, result);
+
+    case BuiltinOperator::TRANSPOSE:
+      return FoldTranspose(op, result);
+
+    case BuiltinOperator::DEQUANTIZE:
+      return FoldDequantize(op, result);
+
+    case BuiltinOperator::CAST:
+      return FoldCast(op, result);
+
+    case BuiltinOperator::RELU:
+    case BuiltinOperator::RELU1:
+    case BuiltinOperator::RELU6:
+    case BuiltinOperator::TANH:
+    case BuiltinOperator::LOGISTIC:
+    case BuiltinOperator::EXP:
+    case BuiltinOperator::NEG:
+      return FoldUnary(op, result);
+
+    case BuiltinOperator::ADD:
+    case BuiltinOperator::SUB:
+    case BuiltinOperator::MUL:
+    case BuiltinOperator::DIV:
+    case BuiltinOperator::MAXIMUM:
+    case BuiltinOperator::MINIMUM:
+      return FoldBinary(op, result);
+
+    default:
+      return false;
+  }
+}
+
+int ConstantFolding::Run() {
+  Graph& graph = model_.graph();
+  std::vector<Operator>& operators = graph.Operators();
+
+  std::vector<bool> removed(operators.size(), false);
+  int count = 0;
+
+  for (size_t i = 0; i < operators.size(); i++) {
+    const Operator& op = operators[i];
+
+    if (op.inputs().empty() || op.outputs().size() != 1) {
+      continue;
+    }
+
+    // a graph output must still be computed by the model
+    int output = op.outputs()[0];
+    if (IsConstant(output) || index_.IsGraphOutput(output)) {
+      continue;
+    }
+
+    bool all_constant = std::all_of(op.inputs().begin(), op.inputs().end(),
+        [this](int index) { return IsConstant(index); });
+
+    if (!all_constant) {
+      continue;
+    }
+
+    std::vector<u_char> result;
+    Tensor& tensor = graph.Tensors()[output];
+
+    if (!Fold(op, result) || result.empty() ||
+        result.size() != TensorByteSize(tensor)) {
+      continue;
+    }
+
+    uint buffer_index = model_.AddBuffer(std::move(result));
+    tensor.SetBuffer(model_.Buffers()[buffer_index], buffer_index);
+
+    removed[i] = true;
+    ++count;
+  }
+
+  graph.RemoveOperators(removed);
+  return count;
+}
+
+}
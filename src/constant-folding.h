@@ -0,0 +1,47 @@
+#ifndef NNT_CONSTANT_FOLDING_H
+#define NNT_CONSTANT_FOLDING_H
+
+#include <vector>
+
+#include "model.h"
+#include "graph-index.h"
+
+namespace nnt {
+
+// Evaluates at transpile time the operators whose inputs are all constant
+// tensors. The result is stored as a new buffer of the model, so it goes to
+// the weights file, the output tensor is bound to it and the operator is
+// removed from the graph. Operators are visited on graph order, so chains of
+// constant operators are folded on a single run.
+class ConstantFolding {
+ public:
+  ConstantFolding(Model& model, const GraphIndex& index)
+    : model_(model)
+    , index_(index) {}
+
+  // returns the number of operators folded
+  int Run();
+
+ private:
+  bool IsConstant(int index);
+
+  // evaluates the operator, returns false if the operator or the types of
+  // its tensors are not supported, in this case the graph is not changed
+  bool Fold(const Operator& op, std::vector<u_char>& result);
+
+  bool FoldCopy(const Operator& op, std::vector<u_char>& result);
+  bool FoldTranspose(const Operator& op, std::vector<u_char>& result);
+  bool FoldDequantize(const Operator& op, std::vector<u_char>& result);
+  bool FoldCast(const Operator& op, std::vector<u_char>& result);
+  bool FoldUnary(const Operator& op, std::vector<u_char>& result);
+  bool FoldBinary(const Operator& op, std::vector<u_char>& result);
+
+  const Tensor& GetTensor(int index);
+
+  Model& model_;
+  const GraphIndex& index_;
+};
+
+}
+
+#endif  // NNT_CONSTANT_FOLDING_H
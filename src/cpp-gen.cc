@@ -1,33 +1,179 @@
 #include "cpp-gen.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include <functional>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
 #include <boost/algorithm/string.hpp>
 
+#include "cpu-gen.h"
 #include "exception.h"
 
 namespace nnt {
 
-std::string TensorsHeader::Generate() {
-  const std::vector<Buffer>& buffers = model_.Buffers();
-  std::string str_buf;
+TensorsHeader::TensorsHeader(Model& model, size_t alignment,
+    const TensorsHeader* previous, bool half_floats)
+  : model_(model)
+  , alignment_(alignment)
+  , half_floats_(half_floats)
+  , start_(previous ? previous->total_size_ : 0)
+  , file_start_(previous ? previous->file_size_ : 0)
+  , total_size_(0)
+  , file_size_(0)
+  , kept_floats_(0) {
+  if (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0) {
+    FATAL(boost::format("Alignment must be a power of two: %1%")%alignment_)
+  }
+
+  Layout(previous);
+}
+
+// no finite value overflows to infinity, from 65520 up, the tiny values that
+// become 0 are the usual rounding of fp16
+static bool FitsHalf(const Buffer& buffer) {
+  for (float value : ReadBuffer<float>(buffer)) {
+    float half = HalfToFloat(FloatToHalf(value));
+
+    if (std::isfinite(value) && !std::isfinite(half)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::vector<bool> TensorsHeader::FloatBuffers(std::vector<bool>& kept) {
+  const std::deque<Buffer>& buffers = model_.Buffers();
+  std::vector<bool> float_buffers(buffers.size(), half_floats_);
+  kept.assign(buffers.size(), false);
+
+  // a buffer shared with a tensor of other type keeps its bytes
+  for (const auto& tensor : model_.graph().Tensors()) {
+    if (tensor.tensor_type() != TensorType::FLOAT32) {
+      float_buffers[tensor.buffer_index()] = false;
+    }
+  }
+
+  // values out of the range of fp16 keep the buffer as FLOAT32
+  for (size_t i = 0; i < buffers.size(); i++) {
+    if (float_buffers[i] && !FitsHalf(buffers[i])) {
+      float_buffers[i] = false;
+      kept[i] = true;
+    }
+  }
+
+  return float_buffers;
+}
 
-  for (const auto& buf : buffers) {
-    if (buf.Data().size() > 0) {
-      std::string str_vec = "";
-      for (const auto& c : buf.Data()) {
-        str_buf += c;
+void TensorsHeader::Layout(const TensorsHeader* previous) {
+  const std::deque<Buffer>& buffers = model_.Buffers();
+  size_t offset = start_;
+  size_t file_offset = file_start_;
+
+  if (previous) {
+    placed_ = previous->placed_;
+    segments_ = previous->segments_;
+  }
+
+  offsets_.resize(buffers.size(), 0);
+  file_offsets_.resize(buffers.size(), 0);
+  written_.resize(buffers.size(), false);
+  std::vector<bool> kept;
+  half_ = FloatBuffers(kept);
+
+  // only the buffers of the tensors on the graph go to the file
+  std::vector<bool> used(buffers.size(), false);
+  for (const auto& tensor : model_.graph().Tensors()) {
+    used[tensor.buffer_index()] = true;
+  }
+
+  for (size_t i = 0; i < buffers.size(); i++) {
+    const Buffer& buf = buffers[i];
+
+    if (buf.Empty() || !used[i]) {
+      continue;
+    }
+
+    size_t hash = std::hash<std::string_view>()(std::string_view(
+        reinterpret_cast<const char*>(buf.RawData()), buf.Size()));
+
+    // the hash only selects the candidates, the content is always compared
+    bool duplicated = false;
+    auto range = placed_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      const Placed& other = it->second;
+
+      if (other.half == half_[i] && other.buffer->Size() == buf.Size() &&
+          std::memcmp(other.buffer->RawData(), buf.RawData(),
+              buf.Size()) == 0) {
+        offsets_[i] = other.offset;
+        duplicated = true;
+        break;
       }
     }
+
+    if (duplicated) {
+      continue;
+    }
+
+    offset = (offset + alignment_ - 1) & ~(alignment_ - 1);
+    file_offset = (file_offset + alignment_ - 1) & ~(alignment_ - 1);
+    offsets_[i] = offset;
+    file_offsets_[i] = file_offset;
+    written_[i] = true;
+    kept_floats_ += kept[i] ? 1 : 0;
+    offset += buf.Size();
+    file_offset += half_[i] ? buf.Size() / 2 : buf.Size();
+    placed_.emplace(hash, Placed{&buf, half_[i], offsets_[i]});
+    segments_.push_back(Segment{file_offsets_[i], offsets_[i], buf.Size(),
+        half_[i]});
   }
 
-  return str_buf;
+  total_size_ = offset;
+  file_size_ = file_offset;
 }
 
-std::string TensorsHeader::Assembler() {
-  return Generate();
+void TensorsHeader::Write(std::ostream& os) const {
+  const std::deque<Buffer>& buffers = model_.Buffers();
+  const std::vector<char> padding(alignment_, 0);
+  size_t pos = file_start_;
+
+  // buffers are written directly from the model data, only the padding
+  // between them and the halfs are written from a separated block
+  for (size_t i = 0; i < buffers.size(); i++) {
+    if (!written_[i]) {
+      continue;
+    }
+
+    if (file_offsets_[i] > pos) {
+      os.write(padding.data(), file_offsets_[i] - pos);
+      pos = file_offsets_[i];
+    }
+
+    const Buffer& buf = buffers[i];
+
+    if (!half_[i]) {
+      os.write(reinterpret_cast<const char*>(buf.RawData()), buf.Size());
+      pos += buf.Size();
+      continue;
+    }
+
+    std::vector<float> values = ReadBuffer<float>(buf);
+    std::vector<uint16_t> halfs(values.size());
+    for (size_t j = 0; j < halfs.size(); j++) {
+      halfs[j] = FloatToHalf(values[j]);
+    }
+
+    os.write(reinterpret_cast<const char*>(halfs.data()),
+        halfs.size() * sizeof(uint16_t));
+    pos += halfs.size() * sizeof(uint16_t);
+  }
 }
 
 std::string ModelGen::Generate() {
@@ -41,6 +187,10 @@ std::string ModelGen::TensorTypeStr(TensorType type) {
       return "ANEURALNETWORKS_TENSOR_FLOAT32";
       break;
 
+    case TensorType::FLOAT16:
+      return "ANEURALNETWORKS_TENSOR_FLOAT16";
+      break;
+
     case TensorType::INT32:
       return "ANEURALNETWORKS_TENSOR_INT32";
       break;
@@ -49,15 +199,76 @@ std::string ModelGen::TensorTypeStr(TensorType type) {
       return "ANEURALNETWORKS_TENSOR_QUANT8_ASYMM";
       break;
 
+    case TensorType::INT8:
+      return "ANEURALNETWORKS_TENSOR_QUANT8_ASYMM_SIGNED";
+      break;
+
     default:
       FATAL("Tensor type not valid for Android NNAPI")
   }
 }
 
+// per-channel tensors other than the INT32 biases, which are described by
+// an operand with scale 0, NNAPI computes their scales from the input and
+// the filter
+static bool IsSymmPerChannel(const Tensor& tensor) {
+  return tensor.HasQuantization() && tensor.quantization().PerChannel() &&
+      tensor.tensor_type() != TensorType::INT32;
+}
+
+std::string ModelGen::OperandTypeStr(const Tensor& tensor) {
+  if (!IsSymmPerChannel(tensor)) {
+    return TensorTypeStr(tensor.tensor_type());
+  }
+
+  if (tensor.tensor_type() != TensorType::INT8) {
+    FATAL(boost::format("Per-channel tensor %1% must be INT8 on Android "
+        "NNAPI")%tensor.name())
+  }
+
+  for (long zero_point : tensor.quantization().zero_point) {
+    if (zero_point != 0) {
+      FATAL(boost::format("Per-channel tensor %1% must have zero points 0 on "
+          "Android NNAPI")%tensor.name())
+    }
+  }
+
+  return "ANEURALNETWORKS_TENSOR_QUANT8_SYMM_PER_CHANNEL";
+}
+
+std::string ModelGen::GenerateChannelQuant(const Tensor& tensor, int count) {
+  const QuantizationParameters& quant = tensor.quantization();
+  std::stringstream ss;
+
+  ss << "static const float channel_scales_" << count << "[] = {";
+  for (size_t i = 0; i < quant.scale.size(); i++) {
+    ss << (i > 0 ? ", " : "") << FloatLiteral(quant.scale[i]);
+  }
+  ss << "};\n";
+
+  ss << "ANeuralNetworksSymmPerChannelQuantParams channel_quant_" << count
+     << " {\n";
+  ss << "  .channelDim = " << quant.quantized_dimension << ",\n";
+  ss << "  .scaleCount = " << quant.scale.size() << ",\n";
+  ss << "  .scales = channel_scales_" << count << "\n";
+  ss << "};\n\n";
+
+  ss << "status = ANeuralNetworksModel_setOperandSymmPerChannelQuantParams("
+     << "model, " << count << ", &channel_quant_" << count << ");\n";
+  ss << CheckStatus(boost::format("ANeuralNetworksModel_"
+      "setOperandSymmPerChannelQuantParams failed for operand %1%")%count);
+
+  return ss.str();
+}
+
 std::string ModelGen::TensorCppTypeStr(TensorType type) {
   switch (type) {
     case TensorType::FLOAT32:
-      return "FLOAT16";
+      return "float";
+      break;
+
+    case TensorType::FLOAT16:
+      return "uint16_t";
       break;
 
     case TensorType::INT32:
@@ -68,6 +279,10 @@ std::string ModelGen::TensorCppTypeStr(TensorType type) {
       return "char";
       break;
 
+    case TensorType::INT8:
+      return "int8_t";
+      break;
+
     default:
       FATAL("Tensor type not valid for Android NNAPI")
   }
@@ -80,13 +295,106 @@ std::string ModelGen::TensorDim(const std::vector<int>& dim) {
     str_out += std::to_string(e) + ",";
   }
 
-  str_out = str_out.substr(0, str_out.length() - 2);
+  if (!dim.empty()) {
+    str_out = str_out.substr(0, str_out.length() - 1);
+  }
+
   str_out += "}";
 
   return str_out;
 }
 
+std::string ModelGen::FloatLiteral(float value) {
+  std::stringstream ss;
+  ss << std::setprecision(9) << value;
+
+  std::string str = ss.str();
+  if (str.find_first_of(".e") == std::string::npos) {
+    str += ".0";
+  }
+
+  return str + "f";
+}
+
+std::string ModelGen::LoadWeights(const TensorsHeader& tensors_header,
+    bool cpu_backend) {
+  const std::vector<TensorsHeader::Segment>& segments =
+      tensors_header.Segments();
+
+  bool has_half = std::any_of(segments.begin(), segments.end(),
+      [](const TensorsHeader::Segment& segment) { return segment.half; });
+
+  if (!has_half) {
+    if (cpu_backend) {
+      return "static bool LoadWeights() {\n  return true;\n}\n\n";
+    }
+
+    return "static bool LoadWeights(int* /*fd*/, size_t* /*size*/) {\n"
+        "  return true;\n}\n\n";
+  }
+
+  std::string str =
+#include "templates/half_weights.tpl"
+  ;
+
+  std::stringstream ss;
+  for (const auto& segment : segments) {
+    ss << "  {" << segment.file_offset << ", " << segment.offset << ", "
+       << segment.size << ", " << (segment.half ? "true" : "false")
+       << "},\n";
+  }
+
+  boost::replace_all(str, "@SEGMENTS", ss.str());
+  boost::replace_all(str, "@FILE_SIZE",
+      std::to_string(tensors_header.FileSize()));
+
+  if (cpu_backend) {
+    str +=
+#include "templates/load_weights_cpu.tpl"
+    ;
+  } else {
+    str +=
+#include "templates/load_weights_nn.tpl"
+    ;
+  }
+
+  boost::replace_all(str, "@WEIGHTS_SIZE",
+      std::to_string(tensors_header.TotalSize()));
+
+  return str;
+}
+
+std::string ModelGen::SizeFunctions(const Graph& graph) {
+  size_t input_size = 0;
+  for (int i : graph.Inputs()) {
+    input_size += TensorByteSize(graph.Tensors()[i]);
+  }
+
+  size_t output_size = 0;
+  for (int i : graph.Outputs()) {
+    output_size += TensorByteSize(graph.Tensors()[i]);
+  }
+
+  std::stringstream ss;
+
+  ss << "size_t InputSize() {\n"
+     << "  return " << input_size << ";\n}\n\n";
+
+  ss << "size_t OutputSize() {\n"
+     << "  return " << output_size << ";\n}\n\n";
+
+  ss << "bool SetInput(const int8_t *buffer, size_t size) {\n"
+     << "  return size == InputSize() && SetInput(buffer);\n}\n\n";
+
+  return ss.str();
+}
+
 float ModelGen::TensorQuantizationScale(const QuantizationParameters& q) {
+  // NNAPI requires 0 on the type of per-channel operands
+  if (q.PerChannel()) {
+    return 0.0f;
+  }
+
   if (q.scale.size() > 0) {
     return q.scale[0];
   } else {
@@ -96,6 +404,10 @@ float ModelGen::TensorQuantizationScale(const QuantizationParameters& q) {
 
 int ModelGen::TensorQuantizationZeroPoint(
     const QuantizationParameters& q) {
+  if (q.PerChannel()) {
+    return 0;
+  }
+
   if (q.zero_point.size() > 0) {
     return q.zero_point[0];
   } else {
@@ -110,7 +422,7 @@ std::string ModelGen::GenerateTensorType(const Tensor& tensor, int count) {
   ss << "uint32_t dimensions_" << count << "[] = " << dimensions << ";\n";
   ss << "ANeuralNetworksOperandType operand_type_" << count << " {\n";
 
-  std::string str_tensor_type = TensorTypeStr(tensor.tensor_type());
+  std::string str_tensor_type = OperandTypeStr(tensor);
   int dimension_count = tensor.shape().size();
 
   float scale;
@@ -157,6 +469,9 @@ std::string ModelGen::GenerateTensorsCode() {
   Graph& graph = model_.graph();
   std::stringstream ss;
 
+  ss << "size_t tensor_size = 0;\n";
+  ss << "size_t offset = 0;\n\n";
+
   int count = 0;
   for (const auto& tensor: graph.Tensors()) {
     // insert operand type
@@ -168,11 +483,17 @@ std::string ModelGen::GenerateTensorsCode() {
     ss << CheckStatus(boost::format("ANeuralNetworksModel_addOperand failed"
         "for operand %1%")%count);
 
-    size_t buf_size = tensor.buffer().Data().size();
+    if (IsSymmPerChannel(tensor)) {
+      ss << GenerateChannelQuant(tensor, count);
+    }
+
+    size_t buf_size = tensor.buffer().Size();
 
     if (buf_size > 0) {
-      // get tensor size
+      // get tensor size and its aligned position on weights file
       ss << "tensor_size = " << buf_size << ";\n";
+      ss << "offset = " << tensors_header_.Offset(tensor.buffer_index())
+         << ";\n";
 
       // insert operand value
       ss << "status = ANeuralNetworksModel_setOperandValueFromMemory(model, ";
@@ -180,22 +501,18 @@ std::string ModelGen::GenerateTensorsCode() {
       ss << CheckStatus(boost::format(
           "ANeuralNetworksModel_setOperandValueFromMemory "
           "failed for operand %1%")%count);
-
-      // calculates the offset
-      ss << "offset += tensor_size;\n";
     }
 
     ++count;
   }
 
   count_operands_ = count;
-  tensor_pos_ = graph.Tensors().size();
 
   return ss.str();
 }
 
 std::string ModelGen::GenerateOpInputs(const std::vector<int>& inputs,
-    size_t num_params) {
+    const std::vector<int>& params) {
   // inputs loop
   std::string str_in = "";
 
@@ -205,9 +522,8 @@ std::string ModelGen::GenerateOpInputs(const std::vector<int>& inputs,
   }
 
   // insert hiperparams like conv stride
-  size_t tensor_start_pos = tensor_pos_;
-  for (; tensor_pos_ < (tensor_start_pos + num_params); tensor_pos_++) {
-    str_in += " " + std::to_string(tensor_pos_) + ",";
+  for (const auto& param : params) {
+    str_in += " " + std::to_string(param) + ",";
   }
 
   str_in = str_in.substr(0, str_in.length() - 1);
@@ -297,29 +613,53 @@ std::string ModelGen::OpTypeStr(BuiltinOperator op_type) {
   }
 }
 
-std::string ModelGen::AddScalarInt32(int value) {
+std::string ModelGen::AddScalarInt32(int value, std::vector<int>& params) {
+  // the same operand is used by all operations with this value
+  auto it = int32_operands_.find(value);
+  if (it != int32_operands_.end()) {
+    params.push_back(it->second);
+    return std::string();
+  }
+
   std::stringstream ss;
 
   ss << "CHECK_ADD_SCALAR(AddScalarInt32(" << count_operands_ << ", "
      << value << "))\n";
 
+  int32_operands_[value] = count_operands_;
+  scalars_.push_back(ScalarOperand{false, value, 0.0f});
+  params.push_back(count_operands_);
   ++count_operands_;
   return ss.str();
 }
 
-std::string ModelGen::AddScalarFloat32(float value) {
+std::string ModelGen::AddScalarFloat32(float value,
+    std::vector<int>& params) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  auto it = float32_operands_.find(bits);
+  if (it != float32_operands_.end()) {
+    params.push_back(it->second);
+    return std::string();
+  }
+
   std::stringstream ss;
 
   ss << "CHECK_ADD_SCALAR(AddScalarFloat32(" << count_operands_ << ", "
      << value << "))\n";
 
+  float32_operands_[bits] = count_operands_;
+  scalars_.push_back(ScalarOperand{true, 0, value});
+  params.push_back(count_operands_);
   ++count_operands_;
   return ss.str();
 }
 
-std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
+std::tuple<std::vector<int>, std::string> ModelGen::OpParams(
+    const Operator& op) {
   std::stringstream ss;
-  size_t num_params = 0;
+  std::vector<int> params;
 
   auto check = [&op](BuiltinOptionsType type) {
     if (op.builtin_op().type != type) {
@@ -328,10 +668,15 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
   };
 
   switch (op.op_code().builtin_code) {
-    case BuiltinOperator::ADD:
-      ss << AddScalarInt32(0);
-      num_params = 1;
+    case BuiltinOperator::ADD: {
+      check(BuiltinOptionsType::AddOptions);
+      const AddOptions& add_options = static_cast<const AddOptions&>(
+          op.builtin_op());
+
+      ss << AddScalarInt32(static_cast<int>(
+          add_options.fused_activation_function), params);
       break;
+    }
 
     case BuiltinOperator::L2_POOL_2D:
     case BuiltinOperator::MAX_POOL_2D:
@@ -340,14 +685,13 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const Pool2DOptions& pool_options = static_cast<const Pool2DOptions&>(
           op.builtin_op());
 
-      ss << AddScalarInt32(static_cast<int>(pool_options.padding));
-      ss << AddScalarInt32(pool_options.stride_w);
-      ss << AddScalarInt32(pool_options.stride_h);
-      ss << AddScalarInt32(pool_options.filter_width);
-      ss << AddScalarInt32(pool_options.filter_height);
+      ss << AddScalarInt32(static_cast<int>(pool_options.padding), params);
+      ss << AddScalarInt32(pool_options.stride_w, params);
+      ss << AddScalarInt32(pool_options.stride_h, params);
+      ss << AddScalarInt32(pool_options.filter_width, params);
+      ss << AddScalarInt32(pool_options.filter_height, params);
       ss << AddScalarInt32(static_cast<int>(
-          pool_options.fused_activation_function));
-      num_params = 6;
+          pool_options.fused_activation_function), params);
       break;
     }
 
@@ -356,12 +700,11 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const Conv2DOptions& conv_options = static_cast<const Conv2DOptions&>(
           op.builtin_op());
 
-      ss << AddScalarInt32(static_cast<int>(conv_options.padding));
-      ss << AddScalarInt32(conv_options.stride_w);
-      ss << AddScalarInt32(conv_options.stride_h);
+      ss << AddScalarInt32(static_cast<int>(conv_options.padding), params);
+      ss << AddScalarInt32(conv_options.stride_w, params);
+      ss << AddScalarInt32(conv_options.stride_h, params);
       ss << AddScalarInt32(static_cast<int>(
-          conv_options.fused_activation_function));
-      num_params = 4;
+          conv_options.fused_activation_function), params);
       break;
     }
 
@@ -370,13 +713,13 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const DepthwiseConv2DOptions& dept_conv_options =
           static_cast<const DepthwiseConv2DOptions&>(op.builtin_op());
 
-      ss << AddScalarInt32(static_cast<int>(dept_conv_options.padding));
-      ss << AddScalarInt32(dept_conv_options.stride_w);
-      ss << AddScalarInt32(dept_conv_options.stride_h);
-      ss << AddScalarInt32(dept_conv_options.depth_multiplier);
+      ss << AddScalarInt32(static_cast<int>(dept_conv_options.padding),
+          params);
+      ss << AddScalarInt32(dept_conv_options.stride_w, params);
+      ss << AddScalarInt32(dept_conv_options.stride_h, params);
+      ss << AddScalarInt32(dept_conv_options.depth_multiplier, params);
       ss << AddScalarInt32(static_cast<int>(
-          dept_conv_options.fused_activation_function));
-      num_params = 5;
+          dept_conv_options.fused_activation_function), params);
       break;
     }
 
@@ -386,8 +729,7 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
           static_cast<const FullyConnectedOptions&>(op.builtin_op());
 
       ss << AddScalarInt32(static_cast<int>(
-          fully_con_options.fused_activation_function));
-      num_params = 1;
+          fully_con_options.fused_activation_function), params);
       break;
     }
 
@@ -396,10 +738,9 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const ConcatenationOptions& concat_options =
           static_cast<const ConcatenationOptions&>(op.builtin_op());
 
-      ss << AddScalarInt32(concat_options.axis);
+      ss << AddScalarInt32(concat_options.axis, params);
       ss << AddScalarInt32(static_cast<int>(
-          concat_options.fused_activation_function));
-      num_params = 2;
+          concat_options.fused_activation_function), params);
       break;
     }
 
@@ -408,8 +749,7 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const SoftmaxOptions& softmax_options =
           static_cast<const SoftmaxOptions&>(op.builtin_op());
 
-      ss << AddScalarFloat32(softmax_options.beta);
-      num_params = 1;
+      ss << AddScalarFloat32(softmax_options.beta, params);
       break;
     }
 
@@ -418,8 +758,7 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
       const SpaceToDepthOptions& space2depth_options =
           static_cast<const SpaceToDepthOptions&>(op.builtin_op());
 
-      ss << AddScalarInt32(space2depth_options.block_size);
-      num_params = 1;
+      ss << AddScalarInt32(space2depth_options.block_size, params);
       break;
     }
 
@@ -430,18 +769,17 @@ std::tuple<size_t, std::string> ModelGen::OpParams(const Operator& op) {
           op.builtin_op());
 
       ss << AddScalarInt32(static_cast<int>(
-          lstm_options.fused_activation_function));
-      ss << AddScalarInt32(lstm_options.cell_clip);
-      ss << AddScalarInt32(lstm_options.proj_clip);
-      num_params = 3;
+          lstm_options.fused_activation_function), params);
+      ss << AddScalarInt32(lstm_options.cell_clip, params);
+      ss << AddScalarInt32(lstm_options.proj_clip, params);
       break;
     }
 
     default:
-      num_params = 0;
+      break;
   }
 
-  return std::tuple<size_t, std::string>(num_params, ss.str());
+  return std::tuple<std::vector<int>, std::string>(params, ss.str());
 }
 
 std::string ModelGen::GenerateOpCode() {
@@ -450,20 +788,20 @@ std::string ModelGen::GenerateOpCode() {
 
   int count = 0;
   for (const auto& op: graph.Operators()) {
-    size_t num_params;
+    std::vector<int> params;
     std::string str_params;
-    std::tie(num_params, str_params) = OpParams(op);
+    std::tie(params, str_params) = OpParams(op);
     ss << str_params << "\n";
     ss << "uint32_t input_operands_" << count << "[] = { ";
-    ss << GenerateOpInputs(op.inputs(), num_params) << " };\n";
+    ss << GenerateOpInputs(op.inputs(), params) << " };\n";
 
     ss << "uint32_t output_operands_" << count << "[] = {";
     ss << GenerateOpOutputs(op.outputs()) << " };\n\n";
 
     ss << "status = ANeuralNetworksModel_addOperation(model, ";
-    ss << OpTypeStr(op.op_code().builtin_code) << ", sizeof(input_operands_" ;
-    ss << count <<"), input_operands_" << count << ", ";
-    ss << "sizeof(output_operands_" << count << "), ";
+    ss << OpTypeStr(op.op_code().builtin_code) << ", ";
+    ss << op.inputs().size() + params.size() << ", input_operands_";
+    ss << count << ", " << op.outputs().size() << ", ";
     ss << "output_operands_" << count << ");\n";
 
     ss << CheckStatus(boost::format(
@@ -475,6 +813,249 @@ std::string ModelGen::GenerateOpCode() {
   return ss.str();
 }
 
+std::string ModelGen::GenerateTables() {
+  Graph& graph = model_.graph();
+  std::stringstream ss_dims;
+  std::stringstream ss_operands;
+  std::stringstream ss_operations;
+  std::stringstream ss_indexes;
+  std::stringstream ss_channel_quants;
+  std::stringstream ss_channel_scales;
+  size_t dims_pos = 0;
+  size_t indexes_pos = 0;
+  size_t num_channel_quants = 0;
+  size_t scales_pos = 0;
+  int operand = 0;
+
+  // operands created from the tensors of the graph
+  for (const auto& tensor: graph.Tensors()) {
+    if (!tensor.shape().empty()) {
+      ss_dims << " ";
+
+      for (int dim : tensor.shape()) {
+        ss_dims << " " << dim << ",";
+      }
+
+      ss_dims << "\n";
+    }
+
+    float scale = 0.0f;
+    int zero_point = 0;
+
+    if (tensor.HasQuantization()) {
+      scale = TensorQuantizationScale(tensor.quantization());
+      zero_point = TensorQuantizationZeroPoint(tensor.quantization());
+    }
+
+    size_t buf_size = tensor.buffer().Size();
+    size_t offset = buf_size > 0 ?
+        tensors_header_.Offset(tensor.buffer_index()) : 0;
+
+    ss_operands << "  {" << OperandTypeStr(tensor) << ", "
+                << dims_pos << ", " << tensor.shape().size() << ", "
+                << FloatLiteral(scale) << ", " << zero_point << ", "
+                << offset << "u, " << buf_size << "u},\n";
+
+    dims_pos += tensor.shape().size();
+
+    if (IsSymmPerChannel(tensor)) {
+      const QuantizationParameters& quant = tensor.quantization();
+
+      ss_channel_quants << "  {" << operand << ", "
+                        << quant.quantized_dimension << ", " << scales_pos
+                        << ", " << quant.scale.size() << "},\n";
+
+      ss_channel_scales << " ";
+      for (float channel_scale : quant.scale) {
+        ss_channel_scales << " " << FloatLiteral(channel_scale) << ",";
+      }
+      ss_channel_scales << "\n";
+
+      scales_pos += quant.scale.size();
+      ++num_channel_quants;
+    }
+
+    ++operand;
+  }
+
+  count_operands_ = graph.Tensors().size();
+
+  // operations, the scalar hyper-parameters are collected on scalars_
+  for (const auto& op: graph.Operators()) {
+    std::vector<int> params;
+    std::tie(params, std::ignore) = OpParams(op);
+
+    size_t num_inputs = op.inputs().size() + params.size();
+    ss_operations << "  {" << OpTypeStr(op.op_code().builtin_code) << ", "
+                  << indexes_pos << ", " << num_inputs << ", "
+                  << indexes_pos + num_inputs << ", " << op.outputs().size()
+                  << "},\n";
+
+    ss_indexes << " ";
+
+    for (int i : op.inputs()) {
+      ss_indexes << " " << i << ",";
+    }
+
+    for (int i : params) {
+      ss_indexes << " " << i << ",";
+    }
+
+    for (int i : op.outputs()) {
+      ss_indexes << " " << i << ",";
+    }
+
+    ss_indexes << "\n";
+    indexes_pos += num_inputs + op.outputs().size();
+  }
+
+  std::stringstream ss_scalars;
+  for (const auto& scalar : scalars_) {
+    if (scalar.is_float) {
+      ss_scalars << "  {ANEURALNETWORKS_FLOAT32, 0, "
+                 << FloatLiteral(scalar.float_value) << "},\n";
+    } else {
+      ss_scalars << "  {ANEURALNETWORKS_INT32, " << scalar.int_value
+                 << ", 0.0f},\n";
+    }
+  }
+
+  std::stringstream ss;
+
+  ss << "struct OperandDesc {\n"
+     << "  int32_t type;\n"
+     << "  uint32_t dims_begin;\n"
+     << "  uint32_t dims_count;\n"
+     << "  float scale;\n"
+     << "  int32_t zero_point;\n"
+     << "  size_t offset;\n"
+     << "  size_t size;\n"
+     << "};\n\n";
+
+  ss << "struct ChannelQuantDesc {\n"
+     << "  uint32_t operand;\n"
+     << "  uint32_t channel_dim;\n"
+     << "  uint32_t scales_begin;\n"
+     << "  uint32_t scales_count;\n"
+     << "};\n\n";
+
+  ss << "struct ScalarDesc {\n"
+     << "  int32_t type;\n"
+     << "  int32_t int_value;\n"
+     << "  float float_value;\n"
+     << "};\n\n";
+
+  ss << "struct OperationDesc {\n"
+     << "  ANeuralNetworksOperationType type;\n"
+     << "  uint32_t inputs_begin;\n"
+     << "  uint32_t inputs_count;\n"
+     << "  uint32_t outputs_begin;\n"
+     << "  uint32_t outputs_count;\n"
+     << "};\n\n";
+
+  // zero length arrays are not valid C++, so every table has a sentinel
+  // and its size is given by a separated constant
+  ss << "static constexpr uint32_t kDimensions[] = {\n" << ss_dims.str()
+     << "  0\n};\n\n";
+
+  ss << "static constexpr size_t kNumOperands = "
+     << graph.Tensors().size() << ";\n";
+  ss << "static constexpr OperandDesc kOperands[] = {\n"
+     << ss_operands.str() << "  {0, 0, 0, 0.0f, 0, 0u, 0u}\n};\n\n";
+
+  ss << "static constexpr size_t kNumChannelQuants = "
+     << num_channel_quants << ";\n";
+  ss << "static constexpr ChannelQuantDesc kChannelQuants[] = {\n"
+     << ss_channel_quants.str() << "  {0, 0, 0, 0}\n};\n\n";
+
+  ss << "static constexpr float kChannelScales[] = {\n"
+     << ss_channel_scales.str() << "  0.0f\n};\n\n";
+
+  ss << "static constexpr size_t kNumScalars = " << scalars_.size()
+     << ";\n";
+  ss << "static constexpr ScalarDesc kScalars[] = {\n"
+     << ss_scalars.str() << "  {0, 0, 0.0f}\n};\n\n";
+
+  ss << "static constexpr size_t kNumOperations = "
+     << graph.Operators().size() << ";\n";
+  ss << "static constexpr OperationDesc kOperations[] = {\n"
+     << ss_operations.str() << "  {0, 0, 0, 0, 0}\n};\n\n";
+
+  ss << "static constexpr uint32_t kOperandIndexes[] = {\n"
+     << ss_indexes.str() << "  0\n};\n\n";
+
+  ss << "for (size_t i = 0; i < kNumOperands; i++) {\n"
+     << "  const OperandDesc& desc = kOperands[i];\n"
+     << "  ANeuralNetworksOperandType operand_type {\n"
+     << "    .type = desc.type,\n"
+     << "    .dimensionCount = desc.dims_count,\n"
+     << "    .dimensions = &kDimensions[desc.dims_begin],\n"
+     << "    .scale = desc.scale,\n"
+     << "    .zeroPoint = desc.zero_point\n"
+     << "  };\n\n"
+     << "  status = ANeuralNetworksModel_addOperand(model, &operand_type);\n"
+     << "  if (status != ANEURALNETWORKS_NO_ERROR) {\n"
+     << "    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n"
+     << "        \"ANeuralNetworksModel_addOperand failed for operand %zu\","
+     << " i);\n"
+     << "    return false;\n"
+     << "  }\n\n"
+     << "  if (desc.size > 0) {\n"
+     << "    status = ANeuralNetworksModel_setOperandValueFromMemory(model, "
+     << "i, mem,\n"
+     << "        desc.offset, desc.size);\n"
+     << "    if (status != ANEURALNETWORKS_NO_ERROR) {\n"
+     << "      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n"
+     << "          \"ANeuralNetworksModel_setOperandValueFromMemory failed "
+     << "for operand %zu\", i);\n"
+     << "      return false;\n"
+     << "    }\n"
+     << "  }\n"
+     << "}\n\n";
+
+  ss << "for (size_t i = 0; i < kNumChannelQuants; i++) {\n"
+     << "  const ChannelQuantDesc& desc = kChannelQuants[i];\n"
+     << "  ANeuralNetworksSymmPerChannelQuantParams channel_quant {\n"
+     << "    .channelDim = desc.channel_dim,\n"
+     << "    .scaleCount = desc.scales_count,\n"
+     << "    .scales = &kChannelScales[desc.scales_begin]\n"
+     << "  };\n\n"
+     << "  status = ANeuralNetworksModel_setOperandSymmPerChannelQuantParams("
+     << "model,\n"
+     << "      desc.operand, &channel_quant);\n"
+     << "  if (status != ANEURALNETWORKS_NO_ERROR) {\n"
+     << "    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n"
+     << "        \"ANeuralNetworksModel_setOperandSymmPerChannelQuantParams "
+     << "failed for operand %u\", desc.operand);\n"
+     << "    return false;\n"
+     << "  }\n"
+     << "}\n\n";
+
+  ss << "for (size_t i = 0; i < kNumScalars; i++) {\n"
+     << "  const ScalarDesc& desc = kScalars[i];\n"
+     << "  int32_t id = kNumOperands + i;\n"
+     << "  bool ok = desc.type == ANEURALNETWORKS_FLOAT32 ?\n"
+     << "      AddScalarFloat32(id, desc.float_value) :\n"
+     << "      AddScalarInt32(id, desc.int_value);\n"
+     << "  CHECK_ADD_SCALAR(ok)\n"
+     << "}\n\n";
+
+  ss << "for (size_t i = 0; i < kNumOperations; i++) {\n"
+     << "  const OperationDesc& desc = kOperations[i];\n"
+     << "  status = ANeuralNetworksModel_addOperation(model, desc.type,\n"
+     << "      desc.inputs_count, &kOperandIndexes[desc.inputs_begin],\n"
+     << "      desc.outputs_count, &kOperandIndexes[desc.outputs_begin]);\n"
+     << "  if (status != ANEURALNETWORKS_NO_ERROR) {\n"
+     << "    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n"
+     << "        \"ANeuralNetworksModel_addOperation failed for operation "
+     << "%zu\", i);\n"
+     << "    return false;\n"
+     << "  }\n"
+     << "}\n\n";
+
+  return ss.str();
+}
+
 std::string ModelGen::GenerateInputsAndOutputs() {
   Graph& graph = model_.graph();
   std::stringstream ss;
@@ -505,6 +1086,14 @@ std::string ModelGen::GenerateInputsAndOutputs() {
      << num_inputs << ", input_indexes, " << num_outputs
      << ", output_indexes);\n";
 
+  // the FLOAT32 operations may run in fp16 where the device supports it
+  if (relaxed_) {
+    ss << "\nstatus = ANeuralNetworksModel_relaxComputationFloat32toFloat16("
+       << "model, true);\n";
+    ss << CheckStatus(boost::format("ANeuralNetworksModel_"
+        "relaxComputationFloat32toFloat16 failed"));
+  }
+
   return ss.str();
 }
 
@@ -522,23 +1111,17 @@ std::string TensorType(const Tensor& tensor) {
       return "int8_t";
       break;
 
+    case TensorType::INT8:
+      return "int8_t";
+      break;
+
     default:
       FATAL("Tensor type not valid for Android NNAPI")
   }
 }
 
-int ModelGen::TensorSize(const Tensor& tensor) {
-  int size = 1;
-  for (int shape_i : tensor.shape()) {
-    size *= shape_i;
-
-    if (tensor.tensor_type() == TensorType::FLOAT32 ||
-        tensor.tensor_type() == TensorType::INT32) {
-      size *= 4;
-    }
-  }
-
-  return size;
+size_t ModelGen::TensorSize(const Tensor& tensor) {
+  return TensorByteSize(tensor);
 }
 
 std::string ModelGen::GenerateInputFunctions() {
@@ -547,10 +1130,10 @@ std::string ModelGen::GenerateInputFunctions() {
 
   str_input += "bool SetInput(const int8_t *buffer) {\n";
 
-  int start = 0;
+  size_t start = 0;
   for (int i : graph.Inputs()) {
     const Tensor& tensor = graph.Tensors()[i];
-    int size = TensorSize(tensor);
+    size_t size = TensorSize(tensor);
 
     str_input += "  int status = ANeuralNetworksExecution_setInput(run, " +
         std::to_string(i) + ", NULL, &buffer[" + std::to_string(start) +
@@ -573,10 +1156,10 @@ std::string ModelGen::GenerateOutputFunctions() {
 
   str_output += "bool SetOutput(int8_t *buffer) {\n";
 
-  int start = 0;
+  size_t start = 0;
   for (int i : graph.Outputs()) {
     const Tensor& tensor = graph.Tensors()[i];
-    int size = TensorSize(tensor);
+    size_t size = TensorSize(tensor);
 
     str_output += "  int status = ANeuralNetworksExecution_setOutput(run, " +
         std::to_string(i) + ", NULL, &buffer[" + std::to_string(start) +
@@ -597,14 +1180,23 @@ std::string ModelGen::GenerateHeader() {
   std::string str =
 #include "templates/top_nn_cc.tpl"
   ;
+
+  boost::replace_all(str, "@LOAD_WEIGHTS",
+      LoadWeights(tensors_header_, false));
   return str;
 }
 
 std::string ModelGen::Assembler() {
   std::string code;
   code = GenerateHeader();
-  code += GenerateTensorsCode();
-  code += GenerateOpCode();
+
+  if (build_mode_ == BuildMode::TABLE) {
+    code += GenerateTables();
+  } else {
+    code += GenerateTensorsCode();
+    code += GenerateOpCode();
+  }
+
   code += GenerateInputsAndOutputs();
 
   // close model function
@@ -612,6 +1204,7 @@ std::string ModelGen::Assembler() {
 
   code += GenerateInputFunctions();
   code += GenerateOutputFunctions();
+  code += SizeFunctions(model_.graph());
 
   // close namespace
   code += "\n}\n\n";
@@ -633,66 +1226,124 @@ std::string ModelGenHeader::Assembler() {
   return str;
 }
 
-template<class Fn>
-int ModelGenJni::TotalSize(Fn&& fn) {
-  Graph& graph = model_.graph();
-  int total_size = 0;
+std::string ModelGenJni::GenerateJni() {
+  std::string str =
+#include "templates/jni.tpl"
+  ;
 
-  for (int i : fn()) {
-    int size = 1;
-    const Tensor& tensor = graph.Tensors()[i];
+  boost::replace_all(str, "@JAVA_PACKAGE", java_package_);
 
-    for (int shape_i : tensor.shape()) {
-      size *= shape_i;
+  return str;
+}
 
-      if (tensor.tensor_type() == TensorType::FLOAT32 ||
-          tensor.tensor_type() == TensorType::INT32) {
-        size *= 4;
-      }
+std::string ModelGenJni::Assembler() {
+  boost::replace_all(java_package_, ".", "_");
+  std::string str = GenerateJni();
+  return str;
+}
+
+std::string ModelGenDispatcher::VariantName(size_t variant) {
+  return "variant" + std::to_string(variant);
+}
+
+std::string ModelGenDispatcher::GenerateTable() {
+  std::stringstream ss;
+
+  // input size -> variant, the size is what selects the variant at runtime
+  std::unordered_map<size_t, size_t> variant_sizes;
+
+  for (size_t v = 0; v < variants_.size(); v++) {
+    const Graph& graph = variants_[v]->graph();
+    size_t input_size = 0;
+    size_t output_size = 0;
+
+    for (int i : graph.Inputs()) {
+      input_size += TensorByteSize(graph.Tensors()[i]);
+    }
+
+    for (int i : graph.Outputs()) {
+      output_size += TensorByteSize(graph.Tensors()[i]);
+    }
+
+    auto it = variant_sizes.find(input_size);
+    if (it != variant_sizes.end()) {
+      FATAL(boost::format("Variants %1% and %2% have inputs of %3% bytes, "
+          "the size of the input can't select the variant")%it->second%v
+          %input_size)
     }
-    total_size += size;
+
+    variant_sizes[input_size] = v;
+
+    std::string name = VariantName(v);
+    ss << "  {" << name << "::OpenTrainingData, " << name << "::CreateModel, "
+       << name << "::Compile,\n"
+       << "   " << name << "::BuildModel, " << name << "::Execute, "
+       << name << "::Cleanup,\n"
+       << "   " << name << "::SetInput, " << name << "::SetOutput, "
+       << input_size << ", " << output_size << "},\n";
   }
 
-  return total_size;
+  return ss.str();
 }
 
-std::string ModelGenJni::GenerateJni() {
-  std::string str =
-#include "templates/jni.tpl"
-  ;
+std::string ModelGenDispatcher::GenerateFunctions() {
+  std::string str;
 
-  Graph& graph = model_.graph();
+  // the number of threads is only set on the cpu backend
+  if (cpu_backend_) {
+    str += "void SetNumThreads(int threads) {\n";
 
-  auto fn_in = std::bind(&Graph::Inputs, &graph);
-  int total_input_size = TotalSize(fn_in);
-
-  auto fn_out = std::bind(&Graph::Outputs, &graph);
-  int total_output_size = TotalSize(fn_out);
+    for (size_t v = 0; v < variants_.size(); v++) {
+      str += "  " + VariantName(v) + "::SetNumThreads(threads);\n";
+    }
 
-  boost::replace_all(str, "@TOTAL_INPUT_SIZE",
-      std::to_string(total_input_size));
-  boost::replace_all(str, "@TOTAL_OUTPUT_SIZE",
-      std::to_string(total_output_size));
-  boost::replace_all(str, "@JAVA_PACKAGE", java_package_);
+    str += "}\n\n";
+  }
 
   return str;
 }
 
-std::string ModelGenJni::Assembler() {
-  boost::replace_all(java_package_, ".", "_");
-  std::string str = GenerateJni();
+std::string ModelGenDispatcher::Assembler() {
+  std::string str =
+#include "templates/dispatcher_cc.tpl"
+  ;
+
+  boost::replace_all(str, "@VARIANTS", GenerateTable());
+  str += GenerateFunctions();
+
+  // close namespace
+  str += "}\n\n";
+
   return str;
 }
 
 void CppGen::GenFiles(const boost::filesystem::path& path,
     const std::string& java_path) {
-  GenTensorsDataFile(path);
-  GenCppFile(path);
+  // the variants share the weights file, each one continues the layout of
+  // the previous one
+  Headers tensors_headers;
+  for (Model* model : models_) {
+    const TensorsHeader* previous = tensors_headers.empty() ?
+        nullptr : tensors_headers.back().get();
+    tensors_headers.push_back(std::make_unique<TensorsHeader>(*model,
+        alignment_, previous, half_floats_));
+  }
+
+  GenTensorsDataFile(path, tensors_headers);
+  GenCppFile(path, tensors_headers);
   GenHFile(path);
-  GenJniFile(path, java_path);
+
+  if (backend_ == Backend::CPU) {
+    GenKernelsFile(path);
+  }
+
+  if (!java_path.empty()) {
+    GenJniFile(path, java_path);
+  }
 }
 
-void CppGen::GenTensorsDataFile(const boost::filesystem::path& path) {
+void CppGen::GenTensorsDataFile(const boost::filesystem::path& path,
+    const Headers& tensors_headers) {
   const boost::filesystem::path& fname("weights_biases.bin");
   std::string str_path = (path / fname).string();
   std::ofstream tensors_file(str_path,
@@ -703,15 +1354,40 @@ void CppGen::GenTensorsDataFile(const boost::filesystem::path& path) {
         %str_path)
   }
 
-  TensorsHeader tensor_header(model_);
-  std::string buf = tensor_header.Assembler();
-  tensors_file.write(buf.c_str(), buf.length());
+  size_t kept_floats = 0;
+  for (const auto& tensors_header : tensors_headers) {
+    tensors_header->Write(tensors_file);
+    kept_floats += tensors_header->KeptFloats();
+  }
+
   tensors_file.close();
 
+  if (!tensors_file) {
+    FATAL(boost::format("Fail on write weights_biases.bin file on: %1%")
+        %str_path)
+  }
+
   std::cout << "File: " << str_path << " generated\n";
+
+  if (kept_floats > 0) {
+    std::cout << "Warning: " << kept_floats << " FLOAT32 buffers out of the "
+              << "fp16 range kept as FLOAT32\n";
+  }
 }
 
-void CppGen::GenCppFile(const boost::filesystem::path& path) {
+std::string CppGen::GenModel(Model& model,
+    const TensorsHeader& tensors_header) {
+  if (backend_ == Backend::CPU) {
+    CpuModelGen model_gen(model, tensors_header);
+    return model_gen.Assembler();
+  }
+
+  ModelGen model_gen(model, tensors_header, build_mode_, half_floats_);
+  return model_gen.Assembler();
+}
+
+void CppGen::GenCppFile(const boost::filesystem::path& path,
+    const Headers& tensors_headers) {
   const boost::filesystem::path& fname("nn.cc");
   std::string str_path = (path / fname).string();
   std::ofstream cc_file(str_path, std::ofstream::out | std::ofstream::binary);
@@ -720,8 +1396,25 @@ void CppGen::GenCppFile(const boost::filesystem::path& path) {
     FATAL("Fail on create nn.cc file")
   }
 
-  ModelGen model(model_);
-  std::string code = model.Assembler();
+  std::string code;
+  if (models_.size() == 1) {
+    code = GenModel(*models_[0], *tensors_headers[0]);
+  } else {
+    // the code of each variant goes to its own namespace inside nnc, and
+    // the functions of nn.h call the variant selected by the input size
+    for (size_t v = 0; v < models_.size(); v++) {
+      std::string variant = GenModel(*models_[v], *tensors_headers[v]);
+      boost::replace_first(variant, "namespace nnc {\n",
+          "namespace nnc {\nnamespace " + ModelGenDispatcher::VariantName(v) +
+          " {\n");
+
+      code += variant + "}\n\n";
+    }
+
+    ModelGenDispatcher dispatcher(models_, backend_ == Backend::CPU);
+    code += dispatcher.Assembler();
+  }
+
   cc_file.write(code.c_str(), code.length());
   cc_file.close();
 
@@ -738,14 +1431,40 @@ void CppGen::GenHFile(const boost::filesystem::path& path) {
     FATAL("Fail on create nn.h file")
   }
 
-  ModelGenHeader model(model_);
-  std::string code = model.Assembler();
+  // the header is the same for every variant
+  std::string code;
+  if (backend_ == Backend::CPU) {
+    CpuModelGenHeader model(*models_[0]);
+    code = model.Assembler();
+  } else {
+    ModelGenHeader model(*models_[0]);
+    code = model.Assembler();
+  }
+
   cc_file.write(code.c_str(), code.length());
   cc_file.close();
 
   std::cout << "File: " << str_path << " generated\n";
 }
 
+void CppGen::GenKernelsFile(const boost::filesystem::path& path) {
+  const boost::filesystem::path& fname("nn_kernels.h");
+  std::string str_path = (path / fname).string();
+
+  std::ofstream h_file(str_path, std::ofstream::out | std::ofstream::binary);
+
+  if (!h_file.is_open()) {
+    FATAL("Fail on create nn_kernels.h file")
+  }
+
+  CpuKernelsGen kernels;
+  std::string code = kernels.Assembler();
+  h_file.write(code.c_str(), code.length());
+  h_file.close();
+
+  std::cout << "File: " << str_path << " generated\n";
+}
+
 void CppGen::GenJniFile(const boost::filesystem::path& path,
     const std::string& java_package) {
   const boost::filesystem::path& fname("jni.cc");
@@ -756,7 +1475,7 @@ void CppGen::GenJniFile(const boost::filesystem::path& path,
     FATAL("Fail on create nn.h file")
   }
 
-  ModelGenJni model(model_, java_package);
+  ModelGenJni model(java_package);
   std::string code = model.Assembler();
   jni_file.write(code.c_str(), code.length());
   jni_file.close();
@@ -1,9 +1,11 @@
 #ifndef nnt_CCP_GEN_H
 #define nnt_CCP_GEN_H
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <tuple>
+#include <unordered_map>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 
@@ -11,29 +13,157 @@
 
 namespace nnt {
 
+// Lays out the constant buffers of the model in the weights_biases.bin file
+// and streams them from the model straight to the file. Every buffer starts
+// on a multiple of the alignment, so the runtime can map the file and use
+// the tensors in place. Buffers with the same content are written only once
+// and share the same offset. A header can continue the layout of a previous
+// one, for the variants of a model that share the same file: its buffers go
+// after the buffers of the previous header, and the ones already placed by
+// it are not written again, so the models of the previous headers must
+// outlive it.
+//
+// With half floats, the buffers read only by FLOAT32 tensors are stored as
+// fp16, so the file has its own, smaller, layout, and the runtime widens it
+// to the float32 layout the offsets refer to when the file is loaded.
 class TensorsHeader {
  public:
-  TensorsHeader(Model& model): model_(model) {}
+  static constexpr size_t kDefaultAlignment = 64;
 
-  std::string Assembler();
+  // a buffer on the file and the place it is loaded to
+  struct Segment {
+    size_t file_offset;
+    size_t offset;
+
+    // bytes once loaded, a half buffer has half of them on file
+    size_t size;
+    bool half;
+  };
+
+  TensorsHeader(Model& model, size_t alignment = kDefaultAlignment,
+      const TensorsHeader* previous = nullptr, bool half_floats = false);
+
+  // writes the buffers of this header, a header that continues another one
+  // must be written right after it
+  void Write(std::ostream& os) const;
+
+  // offset of the buffer once the weights are loaded, the same offset it
+  // has on the file unless the floats are stored as halfs
+  size_t Offset(uint buffer_index) const {
+    return offsets_[buffer_index];
+  }
+
+  // size of the weights once loaded
+  size_t TotalSize() const {
+    return total_size_;
+  }
+
+  // size of the weights file up to the end of this header
+  size_t FileSize() const {
+    return file_size_;
+  }
+
+  bool HalfFloats() const {
+    return half_floats_;
+  }
+
+  // buffers of the file up to the end of this header
+  const std::vector<Segment>& Segments() const {
+    return segments_;
+  }
+
+  // FLOAT32 buffers written by this header that are not stored as halfs
+  // because fp16 can't hold their values
+  size_t KeptFloats() const {
+    return kept_floats_;
+  }
 
  private:
-  std::string Generate();
+  void Layout(const TensorsHeader* previous);
+
+  // the buffers read only by FLOAT32 tensors whose values fit on fp16, the
+  // ones that don't fit are marked on kept
+  std::vector<bool> FloatBuffers(std::vector<bool>& kept);
+
+  struct Placed {
+    const Buffer* buffer;
+    bool half;
+    size_t offset;
+  };
 
   Model& model_;
+  size_t alignment_;
+  bool half_floats_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> file_offsets_;
+
+  // false for empty buffers and for duplicates of a previous buffer
+  std::vector<bool> written_;
+
+  // stored as fp16 on the file
+  std::vector<bool> half_;
+
+  // hash of the content -> buffers already placed on file, by this header
+  // or by the previous ones
+  std::unordered_multimap<size_t, Placed> placed_;
+  std::vector<Segment> segments_;
+
+  // offsets where the buffers of this header start
+  size_t start_;
+  size_t file_start_;
+  size_t total_size_;
+  size_t file_size_;
+  size_t kept_floats_;
 };
 
 class ModelGen {
  public:
-  ModelGen(Model& model): model_(model), tensor_pos_(0) {}
+  // STRAIGHT emits one block of code for each operand and operation of the
+  // model, TABLE emits constant tables with the operands and operations and
+  // a loop that builds the model from them
+  enum class BuildMode { STRAIGHT, TABLE };
+
+  // a relaxed model lets NNAPI compute the FLOAT32 operations in fp16
+  ModelGen(Model& model, const TensorsHeader& tensors_header,
+      BuildMode build_mode = BuildMode::STRAIGHT, bool relaxed = false)
+    : model_(model)
+    , tensors_header_(tensors_header)
+    , build_mode_(build_mode)
+    , relaxed_(relaxed) {}
+
+  // float literal with enough digits to round trip the value
+  static std::string FloatLiteral(float value);
+
+  // InputSize, OutputSize and the SetInput that checks the size of the
+  // buffer, the same on every backend
+  static std::string SizeFunctions(const Graph& graph);
+
+  // LoadWeights, that widens the halfs of the weights file when it is
+  // opened, or does nothing if the file has the layout of the weights
+  static std::string LoadWeights(const TensorsHeader& tensors_header,
+      bool cpu_backend);
 
   std::string Assembler();
 
  private:
+  struct ScalarOperand {
+    bool is_float;
+    int32_t int_value;
+    float float_value;
+  };
+
   std::string Generate();
   std::string GenerateTensorType(const Tensor& tensor, int count);
   std::string GenerateTensorsCode();
   std::string TensorTypeStr(TensorType type);
+
+  // type of the operand of the tensor, per-channel tensors have their own
+  // type on NNAPI
+  std::string OperandTypeStr(const Tensor& tensor);
+
+  // scales of a per-channel operand, they are set apart from the operand
+  // type
+  std::string GenerateChannelQuant(const Tensor& tensor, int count);
   std::string TensorCppTypeStr(TensorType type);
   std::string TensorDim(const std::vector<int>& dim);
   float TensorQuantizationScale(const QuantizationParameters& q);
@@ -41,22 +171,33 @@ class ModelGen {
   std::string CheckStatus(const boost::format& msg);
 
   std::string GenerateOpCode();
+  std::string GenerateTables();
   std::string GenerateOpInputs(const std::vector<int>& inputs,
-      size_t num_params);
+      const std::vector<int>& params);
   std::string GenerateOpOutputs(const std::vector<int>& outputs);
   std::string OpTypeStr(BuiltinOperator op_type);
-  std::tuple<size_t, std::string> OpParams(const Operator& op);
+  std::tuple<std::vector<int>, std::string> OpParams(const Operator& op);
   std::string GenerateInputsAndOutputs();
   std::string GenerateInputFunctions();
   std::string GenerateOutputFunctions();
   std::string GenerateHeader();
-  std::string AddScalarInt32(int value);
-  std::string AddScalarFloat32(float value);
-  int TensorSize(const Tensor& tensor);
+  std::string AddScalarInt32(int value, std::vector<int>& params);
+  std::string AddScalarFloat32(float value, std::vector<int>& params);
+  size_t TensorSize(const Tensor& tensor);
 
   Model& model_;
-  size_t tensor_pos_;
+  const TensorsHeader& tensors_header_;
+  BuildMode build_mode_;
+  bool relaxed_;
   int count_operands_;
+
+  // scalar operands in the order they were added to the model
+  std::vector<ScalarOperand> scalars_;
+
+  // scalar hyper-parameters already added as operands, indexed by value,
+  // float values are indexed by its bits
+  std::unordered_map<int32_t, int> int32_operands_;
+  std::unordered_map<uint32_t, int> float32_operands_;
 };
 
 class ModelGenHeader {
@@ -69,38 +210,95 @@ class ModelGenHeader {
   Model& model_;
 };
 
+// the sizes of the inputs and outputs come from the generated model, so the
+// same JNI works for every variant of the model
 class ModelGenJni {
  public:
-  ModelGenJni(Model& model, const std::string& java_package)
-      : model_(model)
-      , java_package_(java_package) {}
+  ModelGenJni(const std::string& java_package)
+      : java_package_(java_package) {}
 
   std::string Assembler();
  private:
   std::string GenerateJni();
 
-  template<class Fn>
-  int TotalSize(Fn&& fn);
-
-  Model& model_;
   std::string java_package_;
 };
 
+// Generates the functions of nn.h for a model with variants, each function
+// calls the variants generated on the namespaces variant0, variant1, ...
+// The variant that runs is selected by the size of the input buffer, so the
+// variants must have inputs of different sizes.
+class ModelGenDispatcher {
+ public:
+  ModelGenDispatcher(const std::vector<Model*>& variants, bool cpu_backend)
+    : variants_(variants)
+    , cpu_backend_(cpu_backend) {}
+
+  static std::string VariantName(size_t variant);
+
+  std::string Assembler();
+
+ private:
+  std::string GenerateTable();
+  std::string GenerateFunctions();
+
+  const std::vector<Model*>& variants_;
+  bool cpu_backend_;
+};
+
 class CppGen {
  public:
-  CppGen(Model& model): model_(model) {}
+  // NNAPI generates code for the android neural networks api, CPU generates
+  // portable code that runs the model with its own kernels
+  enum class Backend { NNAPI, CPU };
 
+  CppGen(Model& model,
+      size_t alignment = TensorsHeader::kDefaultAlignment,
+      ModelGen::BuildMode build_mode = ModelGen::BuildMode::STRAIGHT,
+      Backend backend = Backend::NNAPI, bool half_floats = false)
+    : CppGen(std::vector<Model*>{&model}, alignment, build_mode, backend,
+          half_floats) {}
+
+  // one variant of the model for each shape of the inputs, every variant is
+  // generated with its own shapes and arena, on the same nn.cc and sharing
+  // the same weights file
+  //
+  // with half floats the FLOAT32 weights are stored as fp16 and widened
+  // when they are loaded, and NNAPI is allowed to compute in fp16
+  CppGen(const std::vector<Model*>& variants,
+      size_t alignment = TensorsHeader::kDefaultAlignment,
+      ModelGen::BuildMode build_mode = ModelGen::BuildMode::STRAIGHT,
+      Backend backend = Backend::NNAPI, bool half_floats = false)
+    : models_(variants)
+    , alignment_(alignment)
+    , build_mode_(build_mode)
+    , backend_(backend)
+    , half_floats_(half_floats) {}
+
+  // jni.cc is only generated when java_path is not empty
   void GenFiles(const boost::filesystem::path& path,
       const std::string& java_path);
 
  private:
-  void GenTensorsDataFile(const boost::filesystem::path& path);
-  void GenCppFile(const boost::filesystem::path& path);
+  using Headers = std::vector<std::unique_ptr<TensorsHeader>>;
+
+  void GenTensorsDataFile(const boost::filesystem::path& path,
+      const Headers& tensors_headers);
+  void GenCppFile(const boost::filesystem::path& path,
+      const Headers& tensors_headers);
   void GenHFile(const boost::filesystem::path& path);
+  void GenKernelsFile(const boost::filesystem::path& path);
   void GenJniFile(const boost::filesystem::path& path,
       const std::string& java_package);
 
-  Model& model_;
+  // code of one variant of the model
+  std::string GenModel(Model& model, const TensorsHeader& tensors_header);
+
+  std::vector<Model*> models_;
+  size_t alignment_;
+  ModelGen::BuildMode build_mode_;
+  Backend backend_;
+  bool half_floats_;
 };
 
 }
@@ -0,0 +1,541 @@
+#include "cpu-gen.h"
+
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+
+#include "reshape-elimination.h"
+#include "concat-elimination.h"
+#include "exception.h"
+
+namespace nnt {
+
+CpuModelGen::CpuModelGen(Model& model, const TensorsHeader& tensors_header)
+  : model_(model)
+  , tensors_header_(tensors_header)
+  , aliases_(Aliases(model.graph()))
+  , memory_planner_(model.graph(), aliases_) {}
+
+std::vector<TensorAlias> CpuModelGen::Aliases(const Graph& graph) {
+  std::vector<TensorAlias> aliases = ReshapeAliases(graph);
+  AddConcatAliases(graph, aliases);
+
+  return aliases;
+}
+
+const Tensor& CpuModelGen::CheckedTensor(int index) {
+  const Tensor& tensor = model_.graph().Tensors()[index];
+
+  // constants too, the kernels read every tensor as float, the packed
+  // weights have an accessor of their own
+  if (tensor.tensor_type() != TensorType::FLOAT32) {
+    FATAL(boost::format("Tensor %1% (%2%) is not FLOAT32, the CPU backend "
+        "only supports FLOAT32 tensors")%index%tensor.name())
+  }
+
+  return tensor;
+}
+
+std::string CpuModelGen::TensorPtr(int index) {
+  // optional tensors are marked with -1
+  if (index < 0) {
+    return "nullptr";
+  }
+
+  const Tensor& tensor = CheckedTensor(index);
+  std::stringstream ss;
+
+  if (!tensor.buffer().Empty()) {
+    ss << "Weights<float>(" << tensors_header_.Offset(tensor.buffer_index())
+       << ")";
+  } else {
+    ss << "Arena<float>(" << memory_planner_.Offset(index) << ")";
+  }
+
+  return ss.str();
+}
+
+std::string CpuModelGen::PackedPtr(int index) {
+  const Tensor& tensor = model_.graph().Tensors()[index];
+
+  if (tensor.tensor_type() != TensorType::UINT8 || tensor.buffer().Empty()) {
+    FATAL(boost::format("Tensor %1% (%2%) is not a constant of packed "
+        "weights")%index%tensor.name())
+  }
+
+  std::stringstream ss;
+  ss << "Weights<uint8_t>(" << tensors_header_.Offset(tensor.buffer_index())
+     << ")";
+
+  return ss.str();
+}
+
+std::string CpuModelGen::TensorShape(int index) {
+  const std::vector<int>& shape = model_.graph().Tensors()[index].shape();
+
+  if (shape.size() > 4) {
+    FATAL(boost::format("Tensor %1% has more than 4 dimensions")%index)
+  }
+
+  // dimensions are aligned to the right, like numpy broadcast
+  std::vector<int> shape4(4 - shape.size(), 1);
+  shape4.insert(shape4.end(), shape.begin(), shape.end());
+
+  std::stringstream ss;
+  ss << "{" << shape4[0] << ", " << shape4[1] << ", " << shape4[2] << ", "
+     << shape4[3] << "}";
+
+  return ss.str();
+}
+
+std::string CpuModelGen::ActivationStr(ActivationFunctionType activation) {
+  switch (activation) {
+    case ActivationFunctionType::NONE:
+      return "kernels::Activation::NONE";
+      break;
+
+    case ActivationFunctionType::RELU:
+      return "kernels::Activation::RELU";
+      break;
+
+    case ActivationFunctionType::RELU1:
+      return "kernels::Activation::RELU1";
+      break;
+
+    case ActivationFunctionType::RELU6:
+      return "kernels::Activation::RELU6";
+      break;
+
+    default:
+      FATAL("Fused activation not supported on CPU backend")
+  }
+}
+
+std::string CpuModelGen::GenerateOp(const Operator& op) {
+  const std::vector<Tensor>& tensors = model_.graph().Tensors();
+  const std::vector<int>& ins = op.inputs();
+  const std::vector<int>& outs = op.outputs();
+  std::stringstream ss;
+
+  auto check = [&op](BuiltinOptionsType type) {
+    if (op.builtin_op().type != type) {
+      FATAL(boost::format("Operator node type wrong"));
+    }
+  };
+
+  auto shape = [&tensors](int index) -> const std::vector<int>& {
+    return tensors[index].shape();
+  };
+
+  auto flat_size = [&tensors](int index) {
+    return TensorByteSize(tensors[index]) /
+        TensorTypeSize(tensors[index].tensor_type());
+  };
+
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::CONV_2D: {
+      check(BuiltinOptionsType::Conv2DOptions);
+      const Conv2DOptions& options = static_cast<const Conv2DOptions&>(
+          op.builtin_op());
+
+      int dilation_w = 1;
+      int dilation_h = 1;
+#ifdef NEWER_TENSORFLOW
+      dilation_w = options.dilation_w_factor;
+      dilation_h = options.dilation_h_factor;
+#endif
+      const std::vector<int>& in = shape(ins[0]);
+      const std::vector<int>& filter = shape(ins[1]);
+      const std::vector<int>& out = shape(outs[0]);
+
+      ss << "  kernels::Conv2D(*pool, " << TensorPtr(ins[0]) << ", "
+         << TensorShape(ins[0]) << ",\n      " << TensorPtr(ins[1]) << ", "
+         << TensorShape(ins[1]) << ", "
+         << TensorPtr(ins.size() > 2 ? ins[2] : -1) << ",\n      "
+         << TensorPtr(outs[0]) << ", " << TensorShape(outs[0]) << ", "
+         << options.stride_w << ", " << options.stride_h << ", "
+         << dilation_w << ", " << dilation_h << ", "
+         << SamePadding(in[2], out[2], filter[2], options.stride_w,
+                dilation_w, options.padding) << ", "
+         << SamePadding(in[1], out[1], filter[1], options.stride_h,
+                dilation_h, options.padding) << ",\n      "
+         << ActivationStr(options.fused_activation_function) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::DEPTHWISE_CONV_2D: {
+      check(BuiltinOptionsType::DepthwiseConv2DOptions);
+      const DepthwiseConv2DOptions& options =
+          static_cast<const DepthwiseConv2DOptions&>(op.builtin_op());
+
+      const std::vector<int>& in = shape(ins[0]);
+      const std::vector<int>& filter = shape(ins[1]);
+      const std::vector<int>& out = shape(outs[0]);
+
+      ss << "  kernels::DepthwiseConv2D(*pool, " << TensorPtr(ins[0]) << ", "
+         << TensorShape(ins[0]) << ",\n      " << TensorPtr(ins[1]) << ", "
+         << TensorShape(ins[1]) << ", "
+         << TensorPtr(ins.size() > 2 ? ins[2] : -1) << ",\n      "
+         << TensorPtr(outs[0]) << ", " << TensorShape(outs[0]) << ", "
+         << options.stride_w << ", " << options.stride_h << ", 1, 1, "
+         << SamePadding(in[2], out[2], filter[2], options.stride_w, 1,
+                options.padding) << ", "
+         << SamePadding(in[1], out[1], filter[1], options.stride_h, 1,
+                options.padding) << ", "
+         << options.depth_multiplier << ",\n      "
+         << ActivationStr(options.fused_activation_function) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::FULLY_CONNECTED: {
+      check(BuiltinOptionsType::FullyConnectedOptions);
+      const FullyConnectedOptions& options =
+          static_cast<const FullyConnectedOptions&>(op.builtin_op());
+
+      // the input is flattened to [batches, depth]
+      const std::vector<int>& weights = shape(ins[1]);
+      size_t units = weights[0];
+      size_t depth = weights[1];
+      size_t batches = flat_size(ins[0]) / depth;
+
+      // 4-bit weights, two on each byte, with the scales of their groups
+      if (ins.size() > 3) {
+        depth *= 2;
+        batches = flat_size(ins[0]) / depth;
+        size_t group_size = depth / shape(ins[3])[1];
+
+        ss << "  kernels::FullyConnectedInt4(*pool, " << TensorPtr(ins[0])
+           << ", " << batches << ", " << depth << ",\n      "
+           << PackedPtr(ins[1]) << ", " << TensorPtr(ins[3]) << ", "
+           << group_size << ", " << TensorPtr(ins[2]) << ",\n      "
+           << TensorPtr(outs[0]) << ", " << units << ", "
+           << ActivationStr(options.fused_activation_function) << ");\n";
+        break;
+      }
+
+      ss << "  kernels::FullyConnected(*pool, " << TensorPtr(ins[0]) << ", "
+         << batches << ", " << depth << ",\n      " << TensorPtr(ins[1])
+         << ", " << TensorPtr(ins.size() > 2 ? ins[2] : -1) << ", "
+         << TensorPtr(outs[0]) << ", " << units << ",\n      "
+         << ActivationStr(options.fused_activation_function) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::AVERAGE_POOL_2D:
+    case BuiltinOperator::MAX_POOL_2D:
+    case BuiltinOperator::L2_POOL_2D: {
+      check(BuiltinOptionsType::Pool2DOptions);
+      const Pool2DOptions& options = static_cast<const Pool2DOptions&>(
+          op.builtin_op());
+
+      std::string pool_type;
+      if (op.op_code().builtin_code == BuiltinOperator::AVERAGE_POOL_2D) {
+        pool_type = "kernels::PoolType::AVERAGE";
+      } else if (op.op_code().builtin_code == BuiltinOperator::MAX_POOL_2D) {
+        pool_type = "kernels::PoolType::MAX";
+      } else {
+        pool_type = "kernels::PoolType::L2";
+      }
+
+      const std::vector<int>& in = shape(ins[0]);
+      const std::vector<int>& out = shape(outs[0]);
+
+      ss << "  kernels::Pool2D(*pool, " << pool_type << ",\n      "
+         << TensorPtr(ins[0]) << ", " << TensorShape(ins[0]) << ",\n      "
+         << TensorPtr(outs[0]) << ", " << TensorShape(outs[0]) << ", "
+         << options.filter_width << ", " << options.filter_height << ", "
+         << options.stride_w << ", " << options.stride_h << ", "
+         << SamePadding(in[2], out[2], options.filter_width,
+                options.stride_w, 1, options.padding) << ", "
+         << SamePadding(in[1], out[1], options.filter_height,
+                options.stride_h, 1, options.padding) << ",\n      "
+         << ActivationStr(options.fused_activation_function) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::CONCATENATION: {
+      check(BuiltinOptionsType::ConcatenationOptions);
+      const ConcatenationOptions& options =
+          static_cast<const ConcatenationOptions&>(op.builtin_op());
+
+      // the producers already wrote the inputs on their slices
+      if (ConcatOnPlace(op, aliases_)) {
+        ss << "  // " << tensors[outs[0]].name() << " written on place\n";
+        break;
+      }
+
+      const std::vector<int>& out = shape(outs[0]);
+      int axis = options.axis < 0 ? options.axis + out.size() : options.axis;
+
+      size_t outer = 1;
+      for (int i = 0; i < axis; i++) {
+        outer *= out[i];
+      }
+
+      std::string str_inputs;
+      std::string str_sizes;
+      for (int in : ins) {
+        str_inputs += " " + TensorPtr(in) + ",";
+        str_sizes += " " + std::to_string(flat_size(in) / outer) + ",";
+      }
+
+      str_inputs = str_inputs.substr(0, str_inputs.length() - 1);
+      str_sizes = str_sizes.substr(0, str_sizes.length() - 1);
+
+      ss << "  {\n"
+         << "    const float* inputs[] = {" << str_inputs << " };\n"
+         << "    const int64_t sizes[] = {" << str_sizes << " };\n"
+         << "    kernels::Concatenation(*pool, inputs, sizes, " << ins.size()
+         << ", " << outer << ",\n        " << TensorPtr(outs[0]) << ", "
+         << ActivationStr(options.fused_activation_function) << ");\n"
+         << "  }\n";
+      break;
+    }
+
+    case BuiltinOperator::SOFTMAX: {
+      check(BuiltinOptionsType::SoftmaxOptions);
+      const SoftmaxOptions& options = static_cast<const SoftmaxOptions&>(
+          op.builtin_op());
+
+      size_t depth = shape(ins[0]).back();
+      size_t rows = flat_size(ins[0]) / depth;
+
+      ss << "  kernels::Softmax(*pool, " << TensorPtr(ins[0]) << ", "
+         << TensorPtr(outs[0]) << ", " << rows << ", " << depth << ", "
+         << ModelGen::FloatLiteral(options.beta) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::RESHAPE:
+    case BuiltinOperator::SQUEEZE: {
+      // the output shares the storage of the input, nothing to run
+      if (aliases_[outs[0]].tensor >= 0) {
+        ss << "  // " << tensors[outs[0]].name() << " is a view of "
+           << tensors[ins[0]].name() << "\n";
+        break;
+      }
+
+      ss << "  kernels::Copy(" << TensorPtr(ins[0]) << ", "
+         << TensorPtr(outs[0]) << ", "
+         << TensorByteSize(tensors[outs[0]]) << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::ADD:
+    case BuiltinOperator::SUB:
+    case BuiltinOperator::MUL:
+    case BuiltinOperator::DIV:
+    case BuiltinOperator::MAXIMUM:
+    case BuiltinOperator::MINIMUM: {
+      std::string binary_op;
+      ActivationFunctionType activation = ActivationFunctionType::NONE;
+
+      switch (op.op_code().builtin_code) {
+        case BuiltinOperator::ADD:
+          check(BuiltinOptionsType::AddOptions);
+          binary_op = "ADD";
+          activation = static_cast<const AddOptions&>(
+              op.builtin_op()).fused_activation_function;
+          break;
+
+        case BuiltinOperator::SUB:
+          check(BuiltinOptionsType::SubOptions);
+          binary_op = "SUB";
+          activation = static_cast<const SubOptions&>(
+              op.builtin_op()).fused_activation_function;
+          break;
+
+        case BuiltinOperator::MUL:
+          check(BuiltinOptionsType::MulOptions);
+          binary_op = "MUL";
+          activation = static_cast<const MulOptions&>(
+              op.builtin_op()).fused_activation_function;
+          break;
+
+        case BuiltinOperator::DIV:
+          check(BuiltinOptionsType::DivOptions);
+          binary_op = "DIV";
+          activation = static_cast<const DivOptions&>(
+              op.builtin_op()).fused_activation_function;
+          break;
+
+        case BuiltinOperator::MAXIMUM:
+          binary_op = "MAXIMUM";
+          break;
+
+        default:
+          binary_op = "MINIMUM";
+      }
+
+      ss << "  kernels::Binary(*pool, kernels::BinaryOp::" << binary_op
+         << ",\n      " << TensorPtr(ins[0]) << ", " << TensorShape(ins[0])
+         << ", " << TensorPtr(ins[1]) << ", " << TensorShape(ins[1])
+         << ",\n      " << TensorPtr(outs[0]) << ", "
+         << TensorShape(outs[0]) << ", " << ActivationStr(activation)
+         << ");\n";
+      break;
+    }
+
+    case BuiltinOperator::RELU:
+    case BuiltinOperator::RELU1:
+    case BuiltinOperator::RELU6:
+    case BuiltinOperator::TANH:
+    case BuiltinOperator::LOGISTIC:
+    case BuiltinOperator::EXP:
+    case BuiltinOperator::NEG: {
+      std::string unary_op;
+
+      switch (op.op_code().builtin_code) {
+        case BuiltinOperator::RELU:
+          unary_op = "RELU";
+          break;
+
+        case BuiltinOperator::RELU1:
+          unary_op = "RELU1";
+          break;
+
+        case BuiltinOperator::RELU6:
+          unary_op = "RELU6";
+          break;
+
+        case BuiltinOperator::TANH:
+          unary_op = "TANH";
+          break;
+
+        case BuiltinOperator::LOGISTIC:
+          unary_op = "LOGISTIC";
+          break;
+
+        case BuiltinOperator::EXP:
+          unary_op = "EXP";
+          break;
+
+        default:
+          unary_op = "NEG";
+      }
+
+      ss << "  kernels::Unary(*pool, kernels::UnaryOp::" << unary_op << ", "
+         << TensorPtr(ins[0]) << ",\n      " << TensorPtr(outs[0]) << ", "
+         << flat_size(outs[0]) << ");\n";
+      break;
+    }
+
+    default:
+      FATAL(boost::format("Operator with %1% not supported on CPU backend")
+          %op.builtin_op_str())
+  }
+
+  return ss.str();
+}
+
+std::string CpuModelGen::GenerateOpCode() {
+  Graph& graph = model_.graph();
+  std::stringstream ss;
+
+  int count = 0;
+  for (const auto& op: graph.Operators()) {
+    ss << "  // operation " << count << "\n";
+    ss << GenerateOp(op) << "\n";
+    ++count;
+  }
+
+  return ss.str();
+}
+
+std::string CpuModelGen::GenerateInputFunctions() {
+  Graph& graph = model_.graph();
+  std::stringstream ss;
+
+  ss << "bool SetInput(const int8_t *buffer) {\n";
+
+  // inputs are packed on the buffer in the same order of the model inputs
+  size_t start = 0;
+  for (int i : graph.Inputs()) {
+    size_t size = TensorByteSize(CheckedTensor(i));
+
+    ss << "  std::memcpy(Arena<int8_t>(" << memory_planner_.Offset(i)
+       << "), &buffer[" << start << "], " << size << ");\n";
+
+    start += size;
+  }
+
+  ss << "  return true;\n}\n\n";
+
+  return ss.str();
+}
+
+std::string CpuModelGen::GenerateOutputFunctions() {
+  Graph& graph = model_.graph();
+  std::stringstream ss;
+
+  ss << "bool SetOutput(int8_t *buffer) {\n";
+
+  size_t start = 0;
+  for (int i : graph.Outputs()) {
+    size_t size = TensorByteSize(CheckedTensor(i));
+
+    ss << "  std::memcpy(&buffer[" << start << "], Arena<int8_t>("
+       << memory_planner_.Offset(i) << "), " << size << ");\n";
+
+    start += size;
+  }
+
+  ss << "  return true;\n}\n\n";
+
+  return ss.str();
+}
+
+std::string CpuModelGen::GenerateHeader() {
+  std::string str =
+#include "templates/top_cpu_cc.tpl"
+  ;
+
+  boost::replace_all(str, "@ARENA_SIZE",
+      std::to_string(memory_planner_.ArenaSize()));
+  boost::replace_all(str, "@LOAD_WEIGHTS",
+      ModelGen::LoadWeights(tensors_header_, true));
+  boost::replace_all(str, "@WEIGHTS_SIZE",
+      std::to_string(tensors_header_.TotalSize()));
+
+  return str;
+}
+
+std::string CpuModelGen::Assembler() {
+  std::string code;
+  code = GenerateHeader();
+  code += GenerateOpCode();
+
+  // close execute function
+  code += "  return true;\n}\n\n";
+
+  code += GenerateInputFunctions();
+  code += GenerateOutputFunctions();
+  code += ModelGen::SizeFunctions(model_.graph());
+
+  // close namespace
+  code += "\n}\n\n";
+
+  return code;
+}
+
+std::string CpuModelGenHeader::GenerateHeader() {
+  std::string str =
+  #include "templates/top_cpu_h.tpl"
+  ;
+  return str;
+}
+
+std::string CpuModelGenHeader::Assembler() {
+  std::string str = GenerateHeader();
+  str += "}";
+
+  return str;
+}
+
+std::string CpuKernelsGen::Assembler() {
+  std::string str =
+#include "templates/cpu_kernels.tpl"
+  ;
+  return str;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef NNT_CPU_GEN_H
+#define NNT_CPU_GEN_H
+
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "cpp-gen.h"
+#include "memory-planner.h"
+
+namespace nnt {
+
+// Generates a self-contained C++ model that runs on the host CPU, every
+// operation is a direct call to the kernels emitted on nn_kernels.h, and the
+// kernels split the work on a persistent thread pool.
+class CpuModelGen {
+ public:
+  CpuModelGen(Model& model, const TensorsHeader& tensors_header);
+
+  std::string Assembler();
+
+  // views used by the generated code: RESHAPE and SQUEEZE outputs and the
+  // CONCATENATION inputs written on place
+  static std::vector<TensorAlias> Aliases(const Graph& graph);
+
+ private:
+  std::string GenerateHeader();
+  std::string GenerateOpCode();
+  std::string GenerateOp(const Operator& op);
+  std::string GenerateInputFunctions();
+  std::string GenerateOutputFunctions();
+
+  std::string TensorPtr(int index);
+
+  // constant of 4-bit weights packed on bytes
+  std::string PackedPtr(int index);
+
+  std::string TensorShape(int index);
+  std::string ActivationStr(ActivationFunctionType activation);
+  const Tensor& CheckedTensor(int index);
+
+  Model& model_;
+  const TensorsHeader& tensors_header_;
+
+  // tensors that are views of the storage of another tensor
+  std::vector<TensorAlias> aliases_;
+
+  // offsets of the non constant tensors inside the activations arena
+  MemoryPlanner memory_planner_;
+};
+
+class CpuModelGenHeader {
+ public:
+  CpuModelGenHeader(Model& model): model_(model) {}
+
+  std::string Assembler();
+
+ private:
+  std::string GenerateHeader();
+
+  Model& model_;
+};
+
+class CpuKernelsGen {
+ public:
+  std::string Assembler();
+};
+
+}
+
+#endif  // NNT_CPU_GEN_H
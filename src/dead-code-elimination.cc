@@ -0,0 +1,74 @@
+#include "dead-code-elimination.h"
+
+namespace nnt {
+
+void DeadCodeElimination::RemoveOperators() {
+  const std::vector<Operator>& operators = graph_.Operators();
+  std::vector<bool> needed(graph_.Tensors().size(), false);
+
+  for (int i : graph_.Outputs()) {
+    needed[i] = true;
+  }
+
+  // operators are on topological order, so walking them backwards an
+  // operator is visited after every operator that reads its outputs
+  std::vector<bool> removed(operators.size(), true);
+  for (int op = operators.size() - 1; op >= 0; op--) {
+    for (int i : operators[op].outputs()) {
+      if (needed[i]) {
+        removed[op] = false;
+        break;
+      }
+    }
+
+    if (removed[op]) {
+      ++removed_operators_;
+      continue;
+    }
+
+    for (int i : operators[op].inputs()) {
+      if (i >= 0) {
+        needed[i] = true;
+      }
+    }
+  }
+
+  graph_.RemoveOperators(removed);
+}
+
+void DeadCodeElimination::RemoveTensors() {
+  std::vector<bool> removed(graph_.Tensors().size(), true);
+
+  auto keep = [&removed](const std::vector<int>& indexes) {
+    for (int i : indexes) {
+      if (i >= 0) {
+        removed[i] = false;
+      }
+    }
+  };
+
+  keep(graph_.Inputs());
+  keep(graph_.Outputs());
+
+  for (const auto& op : graph_.Operators()) {
+    keep(op.inputs());
+    keep(op.outputs());
+  }
+
+  for (bool r : removed) {
+    if (r) {
+      ++removed_tensors_;
+    }
+  }
+
+  if (removed_tensors_ > 0) {
+    graph_.RemoveTensors(removed);
+  }
+}
+
+void DeadCodeElimination::Run() {
+  RemoveOperators();
+  RemoveTensors();
+}
+
+}
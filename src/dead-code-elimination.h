@@ -0,0 +1,40 @@
+#ifndef NNT_DEAD_CODE_ELIMINATION_H
+#define NNT_DEAD_CODE_ELIMINATION_H
+
+#include "model.h"
+
+namespace nnt {
+
+// Removes the operators that don't contribute to the graph outputs and the
+// tensors that are not referenced anymore, the remaining tensors are
+// renumbered so the generated operands only cover what the model uses.
+// Graph inputs are always kept, they are part of the model interface.
+class DeadCodeElimination {
+ public:
+  DeadCodeElimination(Graph& graph)
+    : graph_(graph)
+    , removed_operators_(0)
+    , removed_tensors_(0) {}
+
+  void Run();
+
+  int RemovedOperators() const {
+    return removed_operators_;
+  }
+
+  int RemovedTensors() const {
+    return removed_tensors_;
+  }
+
+ private:
+  void RemoveOperators();
+  void RemoveTensors();
+
+  Graph& graph_;
+  int removed_operators_;
+  int removed_tensors_;
+};
+
+}
+
+#endif  // NNT_DEAD_CODE_ELIMINATION_H
@@ -1,7 +1,10 @@
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 
 #include "dump.h"
+#include "memory-planner.h"
+#include "cpu-gen.h"
 
 namespace nnt {
 
@@ -76,6 +79,10 @@ std::string DumpGraph::TensorType(const Tensor& tensor) {
     case TensorType::STRING:
       return std::string("STRING");
       break;
+
+    case TensorType::INT8:
+      return std::string("INT8");
+      break;
 #ifdef NEWER_TENSORFLOW
     case TensorType::BOOL:
       return std::string("BOOL");
@@ -137,6 +144,21 @@ std::string DumpGraph::Info() {
   }
 
   ss << "\n";
+
+  MemoryPlanner planner(graph, CpuModelGen::Aliases(graph));
+  size_t naive = planner.NaiveSize();
+  size_t arena = planner.ArenaSize();
+
+  ss << "::Memory::\n";
+  ss << " Activations arena: " << arena << " bytes (planned)\n";
+  ss << " Activations naive: " << naive << " bytes";
+
+  if (naive > 0) {
+    ss << " (" << std::fixed << std::setprecision(1)
+       << 100.0 * (naive - arena) / naive << "% saved)";
+  }
+
+  ss << "\n\n";
   return ss.str();
 }
 
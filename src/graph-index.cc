@@ -0,0 +1,50 @@
+#include "graph-index.h"
+
+namespace nnt {
+
+GraphIndex::GraphIndex(const Graph& graph)
+  : producer_(graph.Tensors().size(), -1)
+  , first_consumer_(graph.Tensors().size() + 1, 0)
+  , graph_input_(graph.Tensors().size(), false)
+  , graph_output_(graph.Tensors().size(), false) {
+  const std::vector<Operator>& operators = graph.Operators();
+
+  // count the readers of each tensor first, so the lists of consumers can
+  // be laid out on a single vector
+  for (size_t op = 0; op < operators.size(); op++) {
+    for (int i : operators[op].outputs()) {
+      producer_[i] = op;
+    }
+
+    for (int i : operators[op].inputs()) {
+      if (i >= 0) {
+        first_consumer_[i + 1]++;
+      }
+    }
+  }
+
+  for (size_t i = 1; i < first_consumer_.size(); i++) {
+    first_consumer_[i] += first_consumer_[i - 1];
+  }
+
+  consumers_.resize(first_consumer_.back());
+  std::vector<int> next(first_consumer_.begin(), first_consumer_.end() - 1);
+
+  for (size_t op = 0; op < operators.size(); op++) {
+    for (int i : operators[op].inputs()) {
+      if (i >= 0) {
+        consumers_[next[i]++] = op;
+      }
+    }
+  }
+
+  for (int i : graph.Inputs()) {
+    graph_input_[i] = true;
+  }
+
+  for (int i : graph.Outputs()) {
+    graph_output_[i] = true;
+  }
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef NNT_GRAPH_INDEX_H
+#define NNT_GRAPH_INDEX_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Def-use index of a graph: the operator that writes each tensor and the
+// operators that read it, built with a single walk over the operators.
+// The index is a snapshot, any change on the operators or on the tensors of
+// the graph makes it stale, the pass manager builds a new one after a pass
+// that changed the graph.
+class GraphIndex {
+ public:
+  explicit GraphIndex(const Graph& graph);
+
+  // number of tensors the index covers, tensors added after the index was
+  // built are not on it
+  int NumTensors() const {
+    return producer_.size();
+  }
+
+  // operator that writes the tensor, -1 for constants and graph inputs
+  int Producer(int tensor) const {
+    return producer_[tensor];
+  }
+
+  // operators that read the tensor, an operator that reads it on more than
+  // one input appears once per input
+  const int* ConsumersBegin(int tensor) const {
+    return consumers_.data() + first_consumer_[tensor];
+  }
+
+  const int* ConsumersEnd(int tensor) const {
+    return consumers_.data() + first_consumer_[tensor + 1];
+  }
+
+  int NumConsumers(int tensor) const {
+    return first_consumer_[tensor + 1] - first_consumer_[tensor];
+  }
+
+  // first operator that reads the tensor, -1 if no operator reads it
+  int FirstConsumer(int tensor) const {
+    return NumConsumers(tensor) > 0 ? *ConsumersBegin(tensor) : -1;
+  }
+
+  bool IsGraphInput(int tensor) const {
+    return graph_input_[tensor];
+  }
+
+  bool IsGraphOutput(int tensor) const {
+    return graph_output_[tensor];
+  }
+
+ private:
+  std::vector<int> producer_;
+
+  // the consumers of the tensor i are on consumers_, from
+  // first_consumer_[i] to first_consumer_[i + 1]
+  std::vector<int> first_consumer_;
+  std::vector<int> consumers_;
+
+  std::vector<bool> graph_input_;
+  std::vector<bool> graph_output_;
+};
+
+}
+
+#endif  // NNT_GRAPH_INDEX_H
@@ -0,0 +1,130 @@
+#include "int4-packing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <boost/format.hpp>
+
+#include "exception.h"
+
+namespace nnt {
+
+bool Int4Packing::Eligible(int weights) {
+  Graph& graph = model_.graph();
+  const Tensor& tensor = graph.Tensors()[weights];
+  const std::vector<int>& shape = tensor.shape();
+
+  if (tensor.tensor_type() != TensorType::FLOAT32 ||
+      tensor.buffer().Empty() || shape.size() != 2 ||
+      shape[1] % group_size_ != 0 ||
+      tensor.buffer().Size() != TensorByteSize(tensor)) {
+    return false;
+  }
+
+  // the other operators still need the float weights
+  for (const auto& op : graph.Operators()) {
+    const std::vector<int>& ins = op.inputs();
+
+    for (size_t i = 0; i < ins.size(); i++) {
+      if (ins[i] == weights && (i != 1 ||
+          op.op_code().builtin_code != BuiltinOperator::FULLY_CONNECTED)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+int Int4Packing::Pack(int weights) {
+  Graph& graph = model_.graph();
+  const Tensor& tensor = graph.Tensors()[weights];
+  int units = tensor.shape()[0];
+  int depth = tensor.shape()[1];
+  int groups = depth / group_size_;
+
+  std::vector<float> values = ReadBuffer<float>(tensor.buffer());
+
+  std::vector<u_char> packed(values.size() / 2, 0);
+  std::vector<float> scales(static_cast<size_t>(units) * groups);
+
+  for (size_t g = 0; g < scales.size(); g++) {
+    const float* group = values.data() + g * group_size_;
+    float max = 0.0f;
+
+    for (int i = 0; i < group_size_; i++) {
+      max = std::max(max, std::abs(group[i]));
+    }
+
+    // the values go from -8 to 7, the largest magnitude maps to 7
+    float scale = max > 0 ? max / 7 : 1.0f;
+    scales[g] = scale;
+
+    for (int i = 0; i < group_size_; i++) {
+      long q = std::lround(group[i] / scale);
+      q = std::min(std::max(q, -8L), 7L) + 8;
+
+      size_t index = g * group_size_ + i;
+      packed[index / 2] |= static_cast<u_char>(q << (index % 2 ? 4 : 0));
+    }
+  }
+
+  std::vector<u_char> scales_data(scales.size() * sizeof(float));
+  std::memcpy(scales_data.data(), scales.data(), scales_data.size());
+
+  uint scales_buffer = model_.AddBuffer(std::move(scales_data));
+  graph.AddTensor(Tensor(std::vector<int>{units, groups},
+      TensorType::FLOAT32, tensor.name() + "/int4_scales",
+      model_.Buffers()[scales_buffer], scales_buffer, nullptr));
+
+  // the reference to the weights is not valid after AddTensor
+  Tensor& packed_tensor = graph.Tensors()[weights];
+  uint packed_buffer = model_.AddBuffer(std::move(packed));
+  packed_tensor.SetBuffer(model_.Buffers()[packed_buffer], packed_buffer);
+  packed_tensor.SetTensorType(TensorType::UINT8);
+  packed_tensor.SetShape(std::vector<int>{units, depth / 2});
+
+  return graph.Tensors().size() - 1;
+}
+
+int Int4Packing::Run() {
+  if (group_size_ <= 0 || group_size_ % 2 != 0) {
+    FATAL(boost::format("Group size of the 4-bit weights must be a positive "
+        "even number, got %1%")%group_size_)
+  }
+
+  Graph& graph = model_.graph();
+
+  // weights shared by several operators are packed once
+  std::unordered_map<int, int> scales_of;
+  int count = 0;
+
+  for (auto& op : graph.Operators()) {
+    if (op.op_code().builtin_code != BuiltinOperator::FULLY_CONNECTED ||
+        op.inputs().size() < 2 || op.inputs().size() > 3) {
+      continue;
+    }
+
+    int weights = op.inputs()[1];
+    auto it = scales_of.find(weights);
+
+    if (it == scales_of.end()) {
+      if (!Eligible(weights)) {
+        continue;
+      }
+
+      it = scales_of.emplace(weights, Pack(weights)).first;
+    }
+
+    std::vector<int> inputs = op.inputs();
+    inputs.resize(3, -1);
+    inputs.push_back(it->second);
+    op.SetInputs(std::move(inputs));
+    ++count;
+  }
+
+  return count;
+}
+
+}
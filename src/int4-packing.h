@@ -0,0 +1,37 @@
+#ifndef NNT_INT4_PACKING_H
+#define NNT_INT4_PACKING_H
+
+#include "model.h"
+
+namespace nnt {
+
+// Quantizes the FLOAT32 constant weights of FULLY_CONNECTED operators to 4
+// bits, in groups of group_size weights along the depth, each group with a
+// symmetric scale of its own. The weights tensor becomes a UINT8 tensor of
+// [units, depth / 2], with two values on each byte, and the scales a FLOAT32
+// tensor of [units, depth / group_size] added as the fourth input of the
+// operator, after the bias, that is -1 when the operator has none. Only the
+// CPU backend has kernels for this format. Weights that are read by other
+// operators, or whose depth is not a multiple of the group, are kept.
+class Int4Packing {
+ public:
+  Int4Packing(Model& model, int group_size)
+    : model_(model)
+    , group_size_(group_size) {}
+
+  // returns the number of operators with 4-bit weights
+  int Run();
+
+ private:
+  bool Eligible(int weights);
+
+  // packs the weights on a new buffer and returns the index of the scales
+  int Pack(int weights);
+
+  Model& model_;
+  int group_size_;
+};
+
+}
+
+#endif  // NNT_INT4_PACKING_H
@@ -0,0 +1,563 @@
+#include "interpreter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <boost/format.hpp>
+
+#include "exception.h"
+
+namespace nnt {
+
+static float Activate(float value, ActivationFunctionType activation) {
+  switch (activation) {
+    case ActivationFunctionType::NONE:
+      return value;
+
+    case ActivationFunctionType::RELU:
+      return std::max(value, 0.0f);
+
+    case ActivationFunctionType::RELU1:
+      return std::min(std::max(value, -1.0f), 1.0f);
+
+    case ActivationFunctionType::RELU6:
+      return std::min(std::max(value, 0.0f), 6.0f);
+
+    case ActivationFunctionType::TANH:
+      return std::tanh(value);
+
+    default:
+      FATAL("Fused activation not supported by the interpreter")
+  }
+}
+
+Interpreter::Interpreter(const Graph& graph)
+  : graph_(graph)
+  , values_(graph.Tensors().size()) {
+  const std::vector<Tensor>& tensors = graph.Tensors();
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    const Tensor& tensor = tensors[i];
+
+    if (tensor.tensor_type() != TensorType::FLOAT32) {
+      continue;
+    }
+
+    if (tensor.buffer().Empty()) {
+      values_[i].resize(NumElements(tensor.shape()));
+      continue;
+    }
+
+    values_[i] = ReadBuffer<float>(tensor.buffer());
+  }
+}
+
+std::vector<int> Interpreter::Shape4(int index) const {
+  const std::vector<int>& shape = graph_.Tensors()[index].shape();
+
+  if (shape.size() > 4) {
+    FATAL(boost::format("Tensor %1% has more than 4 dimensions")%index)
+  }
+
+  std::vector<int> shape4(4 - shape.size(), 1);
+  shape4.insert(shape4.end(), shape.begin(), shape.end());
+
+  return shape4;
+}
+
+size_t Interpreter::InputSize() const {
+  size_t size = 0;
+
+  for (int i : graph_.Inputs()) {
+    size += values_[i].size();
+  }
+
+  return size;
+}
+
+void Interpreter::Run(const std::vector<float>& inputs) {
+  if (inputs.size() != InputSize()) {
+    FATAL(boost::format("The interpreter got %1% input values, the graph "
+        "takes %2%")%inputs.size()%InputSize())
+  }
+
+  size_t start = 0;
+  for (int i : graph_.Inputs()) {
+    std::copy(inputs.begin() + start, inputs.begin() + start +
+        values_[i].size(), values_[i].begin());
+    start += values_[i].size();
+  }
+
+  for (const auto& op : graph_.Operators()) {
+    // the shape of a reshape is the only tensor that is not float
+    size_t num_inputs = op.op_code().builtin_code == BuiltinOperator::RESHAPE ?
+        1 : op.inputs().size();
+
+    for (size_t i = 0; i < num_inputs; i++) {
+      CheckFloat(op.inputs()[i]);
+    }
+
+    for (int i : op.outputs()) {
+      CheckFloat(i);
+    }
+
+    RunOp(op);
+  }
+}
+
+void Interpreter::CheckFloat(int index) const {
+  // optional tensors are marked with -1
+  if (index < 0) {
+    return;
+  }
+
+  const Tensor& tensor = graph_.Tensors()[index];
+
+  if (tensor.tensor_type() != TensorType::FLOAT32) {
+    FATAL(boost::format("Tensor %1% (%2%) is not FLOAT32, the interpreter "
+        "only supports FLOAT32 tensors")%index%tensor.name())
+  }
+}
+
+void Interpreter::Conv2D(const Operator& op) {
+  const Conv2DOptions& options = static_cast<const Conv2DOptions&>(
+      op.builtin_op());
+  const std::vector<int>& ins = op.inputs();
+
+  int dilation_w = 1;
+  int dilation_h = 1;
+#ifdef NEWER_TENSORFLOW
+  dilation_w = options.dilation_w_factor;
+  dilation_h = options.dilation_h_factor;
+#endif
+
+  std::vector<int> in = Shape4(ins[0]);
+  std::vector<int> fs = Shape4(ins[1]);
+  std::vector<int> out = Shape4(op.outputs()[0]);
+  const std::vector<float>& input = values_[ins[0]];
+  const std::vector<float>& filter = values_[ins[1]];
+  const float* bias = ins.size() > 2 && ins[2] >= 0 ?
+      values_[ins[2]].data() : nullptr;
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  int pad_w = SamePadding(in[2], out[2], fs[2], options.stride_w,
+      dilation_w, options.padding);
+  int pad_h = SamePadding(in[1], out[1], fs[1], options.stride_h,
+      dilation_h, options.padding);
+
+  size_t o = 0;
+  for (int b = 0; b < out[0]; b++) {
+    for (int oy = 0; oy < out[1]; oy++) {
+      for (int ox = 0; ox < out[2]; ox++) {
+        for (int oc = 0; oc < out[3]; oc++) {
+          float acc = bias ? bias[oc] : 0.0f;
+
+          for (int ky = 0; ky < fs[1]; ky++) {
+            int iy = oy * options.stride_h - pad_h + ky * dilation_h;
+
+            for (int kx = 0; kx < fs[2]; kx++) {
+              int ix = ox * options.stride_w - pad_w + kx * dilation_w;
+
+              if (iy < 0 || iy >= in[1] || ix < 0 || ix >= in[2]) {
+                continue;
+              }
+
+              for (int ic = 0; ic < in[3]; ic++) {
+                acc += input[((size_t(b) * in[1] + iy) * in[2] + ix) * in[3] +
+                    ic] * filter[((size_t(oc) * fs[1] + ky) * fs[2] + kx) *
+                    fs[3] + ic];
+              }
+            }
+          }
+
+          output[o++] = Activate(acc, options.fused_activation_function);
+        }
+      }
+    }
+  }
+}
+
+void Interpreter::DepthwiseConv2D(const Operator& op) {
+  const DepthwiseConv2DOptions& options =
+      static_cast<const DepthwiseConv2DOptions&>(op.builtin_op());
+  const std::vector<int>& ins = op.inputs();
+
+  std::vector<int> in = Shape4(ins[0]);
+  std::vector<int> fs = Shape4(ins[1]);
+  std::vector<int> out = Shape4(op.outputs()[0]);
+  const std::vector<float>& input = values_[ins[0]];
+  const std::vector<float>& filter = values_[ins[1]];
+  const float* bias = ins.size() > 2 && ins[2] >= 0 ?
+      values_[ins[2]].data() : nullptr;
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  int pad_w = SamePadding(in[2], out[2], fs[2], options.stride_w, 1,
+      options.padding);
+  int pad_h = SamePadding(in[1], out[1], fs[1], options.stride_h, 1,
+      options.padding);
+
+  size_t o = 0;
+  for (int b = 0; b < out[0]; b++) {
+    for (int oy = 0; oy < out[1]; oy++) {
+      for (int ox = 0; ox < out[2]; ox++) {
+        for (int oc = 0; oc < out[3]; oc++) {
+          // output channel oc reads the input channel it was multiplied from
+          int ic = oc / options.depth_multiplier;
+          float acc = bias ? bias[oc] : 0.0f;
+
+          for (int ky = 0; ky < fs[1]; ky++) {
+            int iy = oy * options.stride_h - pad_h + ky;
+
+            for (int kx = 0; kx < fs[2]; kx++) {
+              int ix = ox * options.stride_w - pad_w + kx;
+
+              if (iy < 0 || iy >= in[1] || ix < 0 || ix >= in[2]) {
+                continue;
+              }
+
+              acc += input[((size_t(b) * in[1] + iy) * in[2] + ix) * in[3] +
+                  ic] * filter[(size_t(ky) * fs[2] + kx) * fs[3] + oc];
+            }
+          }
+
+          output[o++] = Activate(acc, options.fused_activation_function);
+        }
+      }
+    }
+  }
+}
+
+void Interpreter::FullyConnected(const Operator& op) {
+  const FullyConnectedOptions& options =
+      static_cast<const FullyConnectedOptions&>(op.builtin_op());
+  const std::vector<int>& ins = op.inputs();
+
+  // the input is flattened to [batches, depth]
+  const std::vector<int>& weights_shape = graph_.Tensors()[ins[1]].shape();
+  size_t units = weights_shape[0];
+  size_t depth = weights_shape[1];
+  const std::vector<float>& input = values_[ins[0]];
+  const std::vector<float>& weights = values_[ins[1]];
+  const float* bias = ins.size() > 2 && ins[2] >= 0 ?
+      values_[ins[2]].data() : nullptr;
+  std::vector<float>& output = values_[op.outputs()[0]];
+  size_t batches = input.size() / depth;
+
+  for (size_t b = 0; b < batches; b++) {
+    for (size_t u = 0; u < units; u++) {
+      float acc = 0.0f;
+
+      for (size_t d = 0; d < depth; d++) {
+        acc += input[b * depth + d] * weights[u * depth + d];
+      }
+
+      if (bias) {
+        acc += bias[u];
+      }
+
+      output[b * units + u] = Activate(acc,
+          options.fused_activation_function);
+    }
+  }
+}
+
+void Interpreter::Pool2D(const Operator& op) {
+  const Pool2DOptions& options = static_cast<const Pool2DOptions&>(
+      op.builtin_op());
+  BuiltinOperator code = op.op_code().builtin_code;
+
+  std::vector<int> in = Shape4(op.inputs()[0]);
+  std::vector<int> out = Shape4(op.outputs()[0]);
+  const std::vector<float>& input = values_[op.inputs()[0]];
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  int pad_w = SamePadding(in[2], out[2], options.filter_width,
+      options.stride_w, 1, options.padding);
+  int pad_h = SamePadding(in[1], out[1], options.filter_height,
+      options.stride_h, 1, options.padding);
+
+  size_t o = 0;
+  for (int b = 0; b < out[0]; b++) {
+    for (int oy = 0; oy < out[1]; oy++) {
+      for (int ox = 0; ox < out[2]; ox++) {
+        // only the elements inside the input are counted
+        int y0 = oy * options.stride_h - pad_h;
+        int x0 = ox * options.stride_w - pad_w;
+        int y_begin = std::max(0, y0);
+        int y_end = std::min(in[1], y0 + options.filter_height);
+        int x_begin = std::max(0, x0);
+        int x_end = std::min(in[2], x0 + options.filter_width);
+        int count = (y_end - y_begin) * (x_end - x_begin);
+
+        for (int c = 0; c < out[3]; c++) {
+          float acc = code == BuiltinOperator::MAX_POOL_2D ?
+              std::numeric_limits<float>::lowest() : 0.0f;
+
+          for (int iy = y_begin; iy < y_end; iy++) {
+            for (int ix = x_begin; ix < x_end; ix++) {
+              float v = input[((size_t(b) * in[1] + iy) * in[2] + ix) *
+                  in[3] + c];
+
+              if (code == BuiltinOperator::MAX_POOL_2D) {
+                acc = std::max(acc, v);
+              } else if (code == BuiltinOperator::L2_POOL_2D) {
+                acc += v * v;
+              } else {
+                acc += v;
+              }
+            }
+          }
+
+          if (code == BuiltinOperator::AVERAGE_POOL_2D) {
+            acc = count > 0 ? acc / count : 0.0f;
+          } else if (code == BuiltinOperator::L2_POOL_2D) {
+            acc = count > 0 ? std::sqrt(acc / count) : 0.0f;
+          }
+
+          output[o++] = Activate(acc, options.fused_activation_function);
+        }
+      }
+    }
+  }
+}
+
+void Interpreter::Concatenation(const Operator& op) {
+  const ConcatenationOptions& options =
+      static_cast<const ConcatenationOptions&>(op.builtin_op());
+  const std::vector<int>& out_shape =
+      graph_.Tensors()[op.outputs()[0]].shape();
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  int axis = options.axis < 0 ? options.axis + out_shape.size() :
+      options.axis;
+  size_t outer = NumElements(std::vector<int>(out_shape.begin(),
+      out_shape.begin() + axis));
+
+  // inputs are seen as [outer, size] and are copied side by side
+  size_t o = 0;
+  for (size_t i = 0; i < outer; i++) {
+    for (int in : op.inputs()) {
+      size_t size = values_[in].size() / outer;
+
+      for (size_t k = 0; k < size; k++) {
+        output[o++] = Activate(values_[in][i * size + k],
+            options.fused_activation_function);
+      }
+    }
+  }
+}
+
+void Interpreter::Softmax(const Operator& op) {
+  const SoftmaxOptions& options = static_cast<const SoftmaxOptions&>(
+      op.builtin_op());
+  const std::vector<float>& input = values_[op.inputs()[0]];
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  size_t depth = graph_.Tensors()[op.inputs()[0]].shape().back();
+  size_t rows = input.size() / depth;
+
+  for (size_t r = 0; r < rows; r++) {
+    const float* in = input.data() + r * depth;
+    float* out = output.data() + r * depth;
+    float max = *std::max_element(in, in + depth);
+    float sum = 0.0f;
+
+    for (size_t d = 0; d < depth; d++) {
+      out[d] = std::exp((in[d] - max) * options.beta);
+      sum += out[d];
+    }
+
+    for (size_t d = 0; d < depth; d++) {
+      out[d] /= sum;
+    }
+  }
+}
+
+void Interpreter::Unary(const Operator& op) {
+  const std::vector<float>& input = values_[op.inputs()[0]];
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  for (size_t i = 0; i < input.size(); i++) {
+    float x = input[i];
+
+    switch (op.op_code().builtin_code) {
+      case BuiltinOperator::RELU:
+        x = std::max(x, 0.0f);
+        break;
+
+      case BuiltinOperator::RELU1:
+        x = std::min(std::max(x, -1.0f), 1.0f);
+        break;
+
+      case BuiltinOperator::RELU6:
+        x = std::min(std::max(x, 0.0f), 6.0f);
+        break;
+
+      case BuiltinOperator::TANH:
+        x = std::tanh(x);
+        break;
+
+      case BuiltinOperator::LOGISTIC:
+        x = 1.0f / (1.0f + std::exp(-x));
+        break;
+
+      case BuiltinOperator::EXP:
+        x = std::exp(x);
+        break;
+
+      default:
+        x = -x;
+    }
+
+    output[i] = x;
+  }
+}
+
+void Interpreter::Binary(const Operator& op) {
+  ActivationFunctionType activation = ActivationFunctionType::NONE;
+  const BuiltinOptions& options = op.builtin_op();
+
+  switch (options.type) {
+    case BuiltinOptionsType::AddOptions:
+      activation = static_cast<const AddOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::SubOptions:
+      activation = static_cast<const SubOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::MulOptions:
+      activation = static_cast<const MulOptions&>(
+          options).fused_activation_function;
+      break;
+
+    case BuiltinOptionsType::DivOptions:
+      activation = static_cast<const DivOptions&>(
+          options).fused_activation_function;
+      break;
+
+    default:
+      break;
+  }
+
+  // shapes are aligned to the right, dimensions of size 1 are broadcast
+  std::vector<int> as = Shape4(op.inputs()[0]);
+  std::vector<int> bs = Shape4(op.inputs()[1]);
+  std::vector<int> out = Shape4(op.outputs()[0]);
+  const std::vector<float>& a = values_[op.inputs()[0]];
+  const std::vector<float>& b = values_[op.inputs()[1]];
+  std::vector<float>& output = values_[op.outputs()[0]];
+
+  auto index = [](const std::vector<int>& shape, const int* coord) {
+    size_t i = 0;
+
+    for (int d = 0; d < 4; d++) {
+      i = i * shape[d] + (shape[d] == 1 ? 0 : coord[d]);
+    }
+
+    return i;
+  };
+
+  size_t o = 0;
+  int coord[4];
+  for (coord[0] = 0; coord[0] < out[0]; coord[0]++) {
+    for (coord[1] = 0; coord[1] < out[1]; coord[1]++) {
+      for (coord[2] = 0; coord[2] < out[2]; coord[2]++) {
+        for (coord[3] = 0; coord[3] < out[3]; coord[3]++) {
+          float x = a[index(as, coord)];
+          float y = b[index(bs, coord)];
+          float value;
+
+          switch (op.op_code().builtin_code) {
+            case BuiltinOperator::ADD:
+              value = x + y;
+              break;
+
+            case BuiltinOperator::SUB:
+              value = x - y;
+              break;
+
+            case BuiltinOperator::MUL:
+              value = x * y;
+              break;
+
+            case BuiltinOperator::DIV:
+              value = x / y;
+              break;
+
+            case BuiltinOperator::MAXIMUM:
+              value = std::max(x, y);
+              break;
+
+            default:
+              value = std::min(x, y);
+          }
+
+          output[o++] = Activate(value, activation);
+        }
+      }
+    }
+  }
+}
+
+void Interpreter::RunOp(const Operator& op) {
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::CONV_2D:
+      Conv2D(op);
+      break;
+
+    case BuiltinOperator::DEPTHWISE_CONV_2D:
+      DepthwiseConv2D(op);
+      break;
+
+    case BuiltinOperator::FULLY_CONNECTED:
+      FullyConnected(op);
+      break;
+
+    case BuiltinOperator::AVERAGE_POOL_2D:
+    case BuiltinOperator::MAX_POOL_2D:
+    case BuiltinOperator::L2_POOL_2D:
+      Pool2D(op);
+      break;
+
+    case BuiltinOperator::CONCATENATION:
+      Concatenation(op);
+      break;
+
+    case BuiltinOperator::SOFTMAX:
+      Softmax(op);
+      break;
+
+    case BuiltinOperator::RESHAPE:
+    case BuiltinOperator::SQUEEZE:
+      values_[op.outputs()[0]] = values_[op.inputs()[0]];
+      break;
+
+    case BuiltinOperator::RELU:
+    case BuiltinOperator::RELU1:
+    case BuiltinOperator::RELU6:
+    case BuiltinOperator::TANH:
+    case BuiltinOperator::LOGISTIC:
+    case BuiltinOperator::EXP:
+    case BuiltinOperator::NEG:
+      Unary(op);
+      break;
+
+    case BuiltinOperator::ADD:
+    case BuiltinOperator::SUB:
+    case BuiltinOperator::MUL:
+    case BuiltinOperator::DIV:
+    case BuiltinOperator::MAXIMUM:
+    case BuiltinOperator::MINIMUM:
+      Binary(op);
+      break;
+
+    default:
+      FATAL(boost::format("Operator with %1% not supported by the "
+          "interpreter")%op.builtin_op_str())
+  }
+}
+
+}
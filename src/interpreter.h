@@ -0,0 +1,52 @@
+#ifndef NNT_INTERPRETER_H
+#define NNT_INTERPRETER_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Runs a FLOAT32 graph on the host, at transpile time, with plain reference
+// kernels for the operators the CPU backend supports. It is not meant to be
+// fast, it computes the values of every tensor so the passes can look at
+// them, e.g. to find the range of the activations on calibration data.
+class Interpreter {
+ public:
+  Interpreter(const Graph& graph);
+
+  // number of floats of all inputs together, in the order of the graph
+  // inputs, like the buffer given to SetInput on the generated code
+  size_t InputSize() const;
+
+  // runs the graph with the inputs packed on a single buffer
+  void Run(const std::vector<float>& inputs);
+
+  // values of the tensor on the last run, or of the constant
+  const std::vector<float>& Values(int index) const {
+    return values_[index];
+  }
+
+ private:
+  void RunOp(const Operator& op);
+  void CheckFloat(int index) const;
+
+  void Conv2D(const Operator& op);
+  void DepthwiseConv2D(const Operator& op);
+  void FullyConnected(const Operator& op);
+  void Pool2D(const Operator& op);
+  void Concatenation(const Operator& op);
+  void Softmax(const Operator& op);
+  void Unary(const Operator& op);
+  void Binary(const Operator& op);
+
+  // shape of the tensor aligned to the right on 4 dimensions
+  std::vector<int> Shape4(int index) const;
+
+  const Graph& graph_;
+  std::vector<std::vector<float>> values_;
+};
+
+}
+
+#endif  // NNT_INTERPRETER_H
@@ -1,15 +1,139 @@
 #include <iostream>
+#include <memory>
+#include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
 
 #include "model.h"
 #include "cpp-gen.h"
 #include "dump.h"
+#include "pass-manager.h"
+#include "batch-rewriting.h"
+#include "call-inlining.h"
+#include "int4-packing.h"
+#include "quantization.h"
+#include "shape-rewriting.h"
 #include "exception.h"
 
+// shapes of the inputs of each variant of the model
+using VariantShapes = std::vector<std::vector<std::vector<int>>>;
+
+void OptimizeGraph(nnt::Model& model, int level, int batch,
+    const std::vector<std::vector<int>>& shapes,
+    const std::string& calibration, int int4_group) {
+  nnt::PassManager passes(model);
+
+  // the code is generated for the main graph only, so the calls are always
+  // inlined, before any pass that changes the shapes
+  passes.Add("call-inlining", [](nnt::Model& model, const nnt::GraphIndex&) {
+    return nnt::CallInlining(model).Run();
+  });
+
+  // the new shapes must be set before the shape inference
+  if (!shapes.empty()) {
+    passes.Add("shape-rewriting", [&shapes](nnt::Model& model,
+        const nnt::GraphIndex&) {
+      return nnt::ShapeRewriting(model.graph(), shapes).Run();
+    });
+  }
+
+  if (batch > 0) {
+    passes.Add("batch-rewriting", [batch](nnt::Model& model,
+        const nnt::GraphIndex&) {
+      return nnt::BatchRewriting(model, batch).Run();
+    });
+  }
+
+  passes.AddLevel(level);
+
+  // the ranges are taken from the optimized float graph, so the folded and
+  // fused operators are quantized as they run
+  if (!calibration.empty()) {
+    passes.Add("quantization", [&calibration](nnt::Model& model,
+        const nnt::GraphIndex&) {
+      return nnt::Quantization(model, calibration).Run();
+    });
+  }
+
+  // the packed weights are only read by the cpu kernels, so nothing runs
+  // after the packing
+  if (int4_group > 0) {
+    passes.Add("int4-packing", [int4_group](nnt::Model& model,
+        const nnt::GraphIndex&) {
+      return nnt::Int4Packing(model, int4_group).Run();
+    });
+  }
+
+  passes.Run();
+
+  std::cout << passes.Report() << "\n";
+}
+
+// parses the shapes of the variants, e.g. "1x224x224x3,1x320x320x3", the
+// shapes of the inputs of the same variant are separated by ':'
+VariantShapes ParseShapes(const std::string& str_shapes) {
+  VariantShapes variants;
+  std::vector<std::string> str_variants;
+  boost::split(str_variants, str_shapes, boost::is_any_of(","));
+
+  for (const auto& str_variant : str_variants) {
+    std::vector<std::string> str_inputs;
+    boost::split(str_inputs, str_variant, boost::is_any_of(":"));
+    std::vector<std::vector<int>> inputs;
+
+    for (const auto& str_input : str_inputs) {
+      std::vector<std::string> str_dims;
+      boost::split(str_dims, str_input, boost::is_any_of("x"));
+      std::vector<int> shape;
+
+      for (const auto& str_dim : str_dims) {
+        try {
+          size_t pos;
+          shape.push_back(std::stoi(str_dim, &pos));
+
+          if (pos != str_dim.length()) {
+            throw std::invalid_argument(str_dim);
+          }
+        } catch (const std::logic_error&) {
+          throw nnt::Exception(boost::format("Invalid shape '%1%' on "
+              "--shapes")%str_input);
+        }
+      }
+
+      inputs.push_back(std::move(shape));
+    }
+
+    variants.push_back(std::move(inputs));
+  }
+
+  return variants;
+}
+
 void GenerateJniFiles(const std::string& str_model, const std::string& str_path,
-    const std::string& java_package) {
-  nnt::Model model(str_model);
-  nnt::CppGen cpp(model);
+    const std::string& java_package, size_t alignment, bool table_mode,
+    bool half_floats, nnt::CppGen::Backend backend, int level, int batch,
+    const VariantShapes& variant_shapes, const std::string& calibration,
+    int int4_group) {
+  // a model without variants is a single variant with the shapes of the file
+  VariantShapes shapes = variant_shapes;
+  if (shapes.empty()) {
+    shapes.emplace_back();
+  }
+
+  // the variants must outlive the generator, their buffers are written
+  // when the files are generated
+  std::vector<std::unique_ptr<nnt::Model>> models;
+  std::vector<nnt::Model*> variants;
+
+  for (const auto& shape : shapes) {
+    models.push_back(std::make_unique<nnt::Model>(str_model));
+    OptimizeGraph(*models.back(), level, batch, shape, calibration,
+        int4_group);
+    variants.push_back(models.back().get());
+  }
+
+  nnt::CppGen cpp(variants, alignment, table_mode ?
+      nnt::ModelGen::BuildMode::TABLE : nnt::ModelGen::BuildMode::STRAIGHT,
+      backend, half_floats);
   boost::filesystem::path path(str_path);
   cpp.GenFiles(path, java_package);
   std::cout << "Finish!\n";
@@ -34,10 +158,26 @@ void GenerateDotFile(const std::string& filename,
   std::cout << "Dot file: '" << filename << "' generated.\n";
 }
 
-void Info(const std::string& str_model) {
-  nnt::Model model(str_model);
-  nnt::DumpGraph dump(model);
-  std::cout << dump.Info();
+void Info(const std::string& str_model, int level, int batch,
+    const VariantShapes& variant_shapes, const std::string& calibration,
+    int int4_group) {
+  if (variant_shapes.empty()) {
+    nnt::Model model(str_model);
+    OptimizeGraph(model, level, batch, {}, calibration, int4_group);
+
+    nnt::DumpGraph dump(model);
+    std::cout << dump.Info();
+    return;
+  }
+
+  for (size_t i = 0; i < variant_shapes.size(); i++) {
+    nnt::Model model(str_model);
+    OptimizeGraph(model, level, batch, variant_shapes[i], calibration,
+        int4_group);
+
+    nnt::DumpGraph dump(model);
+    std::cout << "::Variant " << i << "::\n" << dump.Info();
+  }
 }
 
 int main(int argc, char **argv) {
@@ -46,7 +186,16 @@ int main(int argc, char **argv) {
   std::string java_package;
   std::string str_model;
   std::string str_dot;
+  std::string str_backend;
+  std::string calibration;
+  size_t alignment;
   bool flag_info;
+  bool flag_table;
+  bool flag_fp16;
+  int level;
+  int batch;
+  int int4_group;
+  VariantShapes variant_shapes;
 
   try {
     po::options_description desc{"Options"};
@@ -56,7 +205,31 @@ int main(int argc, char **argv) {
       ("dot,d", po::value<std::string>(), "Generate dot file")
       ("model,m", po::value<std::string>(), "flatbuffer neural network model")
       ("path,p", po::value<std::string>(), "store generated files on this path")
-      ("javapackage,j", po::value<std::string>(), "java package for JNI");
+      ("javapackage,j", po::value<std::string>(), "java package for JNI")
+      ("align,a", po::value<size_t>(&alignment)->default_value(
+          nnt::TensorsHeader::kDefaultAlignment),
+          "alignment in bytes of each tensor on weights file")
+      ("table,t", po::bool_switch(&flag_table),
+          "build the model from constant tables instead of straight code")
+      ("fp16", po::bool_switch(&flag_fp16),
+          "store the FLOAT32 weights as fp16 and let NNAPI compute in fp16")
+      ("backend,b", po::value<std::string>(&str_backend)->default_value(
+          "nnapi"), "target of generated code: nnapi or cpu")
+      ("optimize,O", po::value<int>(&level)->default_value(1),
+          "optimization level: 0 keeps the operators as they are, 1 folds and "
+          "fuses operators, 2 also reorders them to reduce the peak memory")
+      ("batch", po::value<int>(&batch)->default_value(0),
+          "batch size of the generated model, 0 keeps the batch of the file")
+      ("shapes", po::value<std::string>(),
+          "generate a variant of the model for each shape of the inputs, "
+          "e.g. 1x224x224x3,1x320x320x3, the inputs of a variant are "
+          "separated by ':'")
+      ("calibration", po::value<std::string>(&calibration),
+          "directory of FLOAT32 inputs, one run on each file, used to "
+          "quantize a float model to UINT8")
+      ("int4-group", po::value<int>(&int4_group)->default_value(0),
+          "quantize the FULLY_CONNECTED weights to 4 bits in groups of this "
+          "size along the depth, 0 keeps them FLOAT32");
 
     po::variables_map vm;
     po::store(parse_command_line(argc, argv, desc), vm);
@@ -75,8 +248,44 @@ int main(int argc, char **argv) {
 
     str_model = vm["model"].as<std::string>();
 
+    if (level < 0 || level > nnt::PassManager::kMaxLevel) {
+      std::cerr << "--optimize must be between 0 and "
+                << nnt::PassManager::kMaxLevel << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
+    if (int4_group < 0 || int4_group % 2 != 0) {
+      std::cerr << "--int4-group must be 0 or a positive even number" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
+    if (batch < 0) {
+      std::cerr << "--batch must not be negative" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
+    if (vm.count("shapes")) {
+      if (batch > 0) {
+        std::cerr << "--batch can't be used with --shapes" << '\n';
+        std::cerr << desc << '\n';
+        return 0;
+      }
+
+      variant_shapes = ParseShapes(vm["shapes"].as<std::string>());
+    }
+
+    // the inputs on the calibration files have the shapes of the file
+    if (!calibration.empty() && !variant_shapes.empty()) {
+      std::cerr << "--calibration can't be used with --shapes" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
     if (flag_info) {
-      Info(str_model);
+      Info(str_model, level, batch, variant_shapes, calibration, int4_group);
       return 0;
     }
 
@@ -92,15 +301,43 @@ int main(int argc, char **argv) {
       str_path = "./";
     }
 
-    if (!vm.count("javapackage")) {
-      std::cerr << "--javapackage must not be empty" << '\n';
+    nnt::CppGen::Backend backend;
+    if (str_backend == "nnapi") {
+      backend = nnt::CppGen::Backend::NNAPI;
+    } else if (str_backend == "cpu") {
+      backend = nnt::CppGen::Backend::CPU;
+    } else {
+      std::cerr << "--backend must be nnapi or cpu" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
+    // the cpu kernels are FLOAT32 only
+    if (!calibration.empty() && backend == nnt::CppGen::Backend::CPU) {
+      std::cerr << "--calibration needs the nnapi backend" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
+
+    // only the cpu kernels read the 4-bit weights
+    if (int4_group > 0 && backend != nnt::CppGen::Backend::CPU) {
+      std::cerr << "--int4-group needs the cpu backend" << '\n';
       std::cerr << desc << '\n';
       return 0;
     }
 
-    java_package = vm["javapackage"].as<std::string>();
+    // the cpu backend can be used without java, so the JNI is optional
+    if (vm.count("javapackage")) {
+      java_package = vm["javapackage"].as<std::string>();
+    } else if (backend == nnt::CppGen::Backend::NNAPI) {
+      std::cerr << "--javapackage must not be empty" << '\n';
+      std::cerr << desc << '\n';
+      return 0;
+    }
 
-    GenerateJniFiles(str_model, str_path, java_package);
+    GenerateJniFiles(str_model, str_path, java_package, alignment,
+        flag_table, flag_fp16, backend, level, batch, variant_shapes,
+        calibration, int4_group);
   } catch (const boost::program_options::error &e) {
     std::cerr << "Error: " << e.what() << '\n';
   } catch (const nnt::Exception& e) {
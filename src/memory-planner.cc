@@ -0,0 +1,156 @@
+#include "memory-planner.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "exception.h"
+
+namespace nnt {
+
+MemoryPlanner::MemoryPlanner(Graph& graph,
+    const std::vector<TensorAlias>& aliases, size_t alignment)
+  : graph_(graph)
+  , aliases_(aliases)
+  , alignment_(alignment)
+  , arena_size_(0)
+  , naive_size_(0) {
+  if (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0) {
+    FATAL(boost::format("Arena alignment must be a power of two: %1%")
+        %alignment_)
+  }
+
+  aliases_.resize(graph_.Tensors().size());
+
+  ComputeLiveRanges();
+  Plan();
+}
+
+size_t MemoryPlanner::Align(size_t value) const {
+  return (value + alignment_ - 1) & ~(alignment_ - 1);
+}
+
+void MemoryPlanner::ComputeLiveRanges() {
+  const std::vector<Tensor>& tensors = graph_.Tensors();
+  const std::vector<Operator>& operators = graph_.Operators();
+  int num_ops = operators.size();
+
+  ranges_.resize(tensors.size());
+  for (size_t i = 0; i < tensors.size(); i++) {
+    ranges_[i].planned = false;
+    ranges_[i].first = num_ops;
+    ranges_[i].last = -1;
+    ranges_[i].size = tensors[i].buffer().Empty() ?
+        TensorByteSize(tensors[i]) : 0;
+  }
+
+  std::vector<bool> used(tensors.size(), false);
+
+  auto use = [this, &tensors, &used](int index, int op) {
+    // optional tensors are marked with -1, constant tensors are not on the
+    // arena
+    if (index < 0 || !tensors[index].buffer().Empty()) {
+      return;
+    }
+
+    used[index] = true;
+
+    LiveRange& range = ranges_[Root(index)];
+    range.planned = true;
+    range.first = std::min(range.first, op);
+    range.last = std::max(range.last, op);
+  };
+
+  for (int i : graph_.Inputs()) {
+    use(i, 0);
+  }
+
+  for (int op = 0; op < num_ops; op++) {
+    for (int i : operators[op].inputs()) {
+      use(i, op);
+    }
+
+    for (int i : operators[op].outputs()) {
+      use(i, op);
+    }
+  }
+
+  for (int i : graph_.Outputs()) {
+    use(i, num_ops);
+  }
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    if (used[i]) {
+      naive_size_ = Align(naive_size_) + TensorByteSize(tensors[i]);
+    }
+  }
+}
+
+void MemoryPlanner::Plan() {
+  std::vector<int> order;
+  for (size_t i = 0; i < ranges_.size(); i++) {
+    if (ranges_[i].planned) {
+      order.push_back(i);
+    }
+  }
+
+  // biggest tensors first, ties keep the order of the graph so the plan
+  // is the same on every run
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return ranges_[a].size > ranges_[b].size;
+  });
+
+  offsets_.assign(ranges_.size(), 0);
+  std::vector<int> placed;
+
+  for (int index : order) {
+    const LiveRange& range = ranges_[index];
+
+    // tensors already placed that are alive at the same time, ordered by
+    // their offsets
+    std::vector<int> alive;
+    for (int p : placed) {
+      if (ranges_[p].first <= range.last && range.first <= ranges_[p].last) {
+        alive.push_back(p);
+      }
+    }
+
+    std::sort(alive.begin(), alive.end(), [this](int a, int b) {
+      return offsets_[a] < offsets_[b];
+    });
+
+    // best fit: the smallest gap between alive tensors that holds the
+    // tensor, or the end of the alive tensors if no gap is big enough
+    size_t candidate = 0;
+    size_t best_offset = 0;
+    size_t best_gap = std::numeric_limits<size_t>::max();
+
+    for (int p : alive) {
+      if (offsets_[p] >= candidate + range.size) {
+        size_t gap = offsets_[p] - candidate;
+
+        if (gap < best_gap) {
+          best_gap = gap;
+          best_offset = candidate;
+        }
+      }
+
+      candidate = std::max(candidate, Align(offsets_[p] + ranges_[p].size));
+    }
+
+    if (best_gap == std::numeric_limits<size_t>::max()) {
+      best_offset = candidate;
+    }
+
+    offsets_[index] = best_offset;
+    arena_size_ = std::max(arena_size_, best_offset + range.size);
+    placed.push_back(index);
+  }
+
+  for (size_t i = 0; i < aliases_.size(); i++) {
+    if (aliases_[i].tensor >= 0) {
+      offsets_[i] = offsets_[aliases_[i].tensor] + aliases_[i].offset;
+    }
+  }
+}
+
+}
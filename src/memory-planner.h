@@ -0,0 +1,85 @@
+#ifndef NNT_MEMORY_PLANNER_H
+#define NNT_MEMORY_PLANNER_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Storage of a tensor inside the storage of another tensor
+struct TensorAlias {
+  // index of the tensor that owns the storage, -1 if the tensor is not an
+  // alias
+  int tensor = -1;
+
+  // byte offset of the alias inside the storage of the owner
+  size_t offset = 0;
+};
+
+// Packs every non constant tensor of the graph into a single arena. Tensors
+// whose live ranges don't overlap share the same region of the arena, the
+// offsets are assigned greedy by size: the biggest tensors are placed first,
+// each one on the smallest gap left by the tensors already placed that are
+// alive at the same time.
+// A tensor can be an alias of another one, aliases[i] tells the tensor whose
+// storage the tensor i uses and where, the live range of the storage covers
+// the uses of both.
+class MemoryPlanner {
+ public:
+  static constexpr size_t kDefaultAlignment = 64;
+
+  MemoryPlanner(Graph& graph,
+      const std::vector<TensorAlias>& aliases = std::vector<TensorAlias>(),
+      size_t alignment = kDefaultAlignment);
+
+  // true if the tensor lives on the arena
+  bool Planned(int index) const {
+    return ranges_[Root(index)].planned;
+  }
+
+  size_t Offset(int index) const {
+    return offsets_[index];
+  }
+
+  // peak size of the arena with the planned offsets
+  size_t ArenaSize() const {
+    return arena_size_;
+  }
+
+  // size of the arena if every tensor, aliases included, had its own region
+  size_t NaiveSize() const {
+    return naive_size_;
+  }
+
+ private:
+  // index of the first and the last operation that use the tensor, graph
+  // inputs are alive from the start and graph outputs until the end
+  struct LiveRange {
+    bool planned;
+    int first;
+    int last;
+    size_t size;
+  };
+
+  void ComputeLiveRanges();
+  void Plan();
+  size_t Align(size_t value) const;
+
+  // tensor that owns the storage used by the tensor
+  int Root(int index) const {
+    return aliases_[index].tensor >= 0 ? aliases_[index].tensor : index;
+  }
+
+  Graph& graph_;
+  std::vector<TensorAlias> aliases_;
+  size_t alignment_;
+  std::vector<LiveRange> ranges_;
+  std::vector<size_t> offsets_;
+  size_t arena_size_;
+  size_t naive_size_;
+};
+
+}
+
+#endif  // NNT_MEMORY_PLANNER_H
@@ -1,51 +1,118 @@
 #include "model.h"
 
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <tuple>
+#include <type_traits>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <boost/functional/hash.hpp>
 
 #include "exception.h"
 
 namespace nnt {
 
-FlatBufferModel::FlatBufferModel(const std::string& fname) {
-  FILE* file = fopen(fname.c_str(), "rb");
-  fseek(file, 0L, SEEK_END);
-  int length = ftell(file);
-  fseek(file, 0L, SEEK_SET);
-  data_ = new char[length];
-  fread(data_, sizeof(char), length, file);
-  fclose(file);
+FlatBufferModel::FlatBufferModel(const std::string& fname, bool use_mmap)
+  : data_(nullptr)
+  , len_(0)
+  , mapped_(false) {
+  int fd = open(fname.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    FATAL(boost::format("Fail on open model file: %1%")%fname)
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    close(fd);
+    FATAL(boost::format("Fail on stat model file: %1%")%fname)
+  }
+
+  size_t length = static_cast<size_t>(sb.st_size);
+
+  // mmap fails for empty files and for some special files, in this case
+  // the file is just read into the memory
+  if (!use_mmap || length == 0 || !MapFile(fd, length)) {
+    ReadFile(fd, length);
+  }
+
+  close(fd);
   len_ = length;
 }
 
+bool FlatBufferModel::MapFile(int fd, size_t length) {
+  void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  // weights are read mostly in sequence when the code is generated
+  madvise(addr, length, MADV_SEQUENTIAL);
+
+  data_ = static_cast<char*>(addr);
+  mapped_ = true;
+  return true;
+}
+
+void FlatBufferModel::ReadFile(int fd, size_t length) {
+  data_ = new char[length];
+
+  size_t total = 0;
+  while (total < length) {
+    ssize_t n = read(fd, data_ + total, length - total);
+
+    if (n <= 0) {
+      delete[] data_;
+      data_ = nullptr;
+      close(fd);
+      FATAL("Fail on read model file")
+    }
+
+    total += n;
+  }
+}
+
 FlatBufferModel::~FlatBufferModel() {
-  delete data_;
+  if (mapped_) {
+    munmap(data_, len_);
+  } else {
+    delete[] data_;
+  }
 }
 
-char* FlatBufferModel::data() {
+const char* FlatBufferModel::data() const {
   return data_;
 }
 
-int FlatBufferModel::Length() const {
+size_t FlatBufferModel::Length() const {
   return len_;
 }
 
-Model::Model(const std::string& fname)
-  : flat_buffers_(fname)
+Model::Model(const std::string& fname, bool use_mmap)
+  : flat_buffers_(fname, use_mmap)
   , fb_model_(tflite::GetModel(flat_buffers_.data())) {
   PopulateBuffers();
   PopulateOperatorsCode();
   PopulateGraph();
 }
 
-void Model::PopulateGraphInputs(const tflite::SubGraph* graph) {
-  std::vector<int> inputs = AssignVector<int>(graph->inputs());
-  graph_.SetInputs(std::move(inputs));
+void Model::PopulateGraphInputs(const tflite::SubGraph* fb_graph,
+    Graph& graph) {
+  std::vector<int> inputs = AssignVector<int>(fb_graph->inputs());
+  graph.SetInputs(std::move(inputs));
 }
 
-void Model::PopulateGraphOutputs(const tflite::SubGraph* graph) {
-  std::vector<int> outputs = AssignVector<int>(graph->outputs());
-  graph_.SetOutputs(std::move(outputs));
+void Model::PopulateGraphOutputs(const tflite::SubGraph* fb_graph,
+    Graph& graph) {
+  std::vector<int> outputs = AssignVector<int>(fb_graph->outputs());
+  graph.SetOutputs(std::move(outputs));
 }
 
 TensorType Model::ConvertTensorType(tflite::TensorType type) {
@@ -73,6 +140,10 @@ TensorType Model::ConvertTensorType(tflite::TensorType type) {
     case tflite::TensorType_STRING:
       return TensorType::STRING;
       break;
+
+    case tflite::TensorType_INT8:
+      return TensorType::INT8;
+      break;
 #ifdef NEWER_TENSORFLOW
     case tflite::TensorType_BOOL:
       return TensorType::BOOL;
@@ -83,8 +154,9 @@ TensorType Model::ConvertTensorType(tflite::TensorType type) {
   }
 }
 
-void Model::PopulateGraphTensors(const tflite::SubGraph* graph) {
-  auto tensors = graph->tensors();
+void Model::PopulateGraphTensors(const tflite::SubGraph* fb_graph,
+    Graph& graph) {
+  auto tensors = fb_graph->tensors();
 
   // get tensors
   for (auto it = tensors->begin(); it != tensors->end(); ++it) {
@@ -104,10 +176,26 @@ void Model::PopulateGraphTensors(const tflite::SubGraph* graph) {
       quantization_ptr->scale = AssignVector<float>(quantization->scale());
       quantization_ptr->zero_point =
           AssignVector<long>(quantization->zero_point());
+      quantization_ptr->quantized_dimension =
+          quantization->quantized_dimension();
+    }
+
+    // a per-channel tensor has one scale for each channel of the dimension
+    const QuantizationParameters& quant = *quantization_ptr;
+    if (quant.PerChannel()) {
+      int dim = quant.quantized_dimension;
+
+      if (dim < 0 || dim >= static_cast<int>(vec_shape.size()) ||
+          static_cast<int>(quant.scale.size()) != vec_shape[dim] ||
+          (quant.zero_point.size() > 1 &&
+          quant.zero_point.size() != quant.scale.size())) {
+        FATAL(boost::format("Tensor %1% has %2% scales, which don't match "
+            "its dimension %3%")%name%quant.scale.size()%dim)
+      }
     }
 
     TensorType type = ConvertTensorType(it->type());
-    graph_.AddTensor(std::move(Tensor(std::move(vec_shape), type, name, buffer,
+    graph.AddTensor(std::move(Tensor(std::move(vec_shape), type, name, buffer,
         buf_index, std::move(quantization_ptr))));
   }
 }
@@ -124,7 +212,7 @@ ActivationFunctionType Model::ConvertActivationFunction(
       break;
 
     case tflite::ActivationFunctionType_RELU_N1_TO_1:
-      return ActivationFunctionType::NONE;
+      return ActivationFunctionType::RELU1;
       break;
 
     case tflite::ActivationFunctionType_RELU6:
@@ -604,6 +692,23 @@ std::unique_ptr<SplitOptions> Model::MakeSplitOptions(
   return option;
 }
 
+std::unique_ptr<StridedSliceOptions> Model::MakeStridedSliceOptions(
+    const tflite::Operator* op) {
+  auto p = reinterpret_cast<const tflite::StridedSliceOptions*>(
+      op->builtin_options());
+
+  std::unique_ptr<StridedSliceOptions> option =
+      std::make_unique<StridedSliceOptions>();
+
+  option->begin_mask = p->begin_mask();
+  option->end_mask = p->end_mask();
+  option->ellipsis_mask = p->ellipsis_mask();
+  option->new_axis_mask = p->new_axis_mask();
+  option->shrink_axis_mask = p->shrink_axis_mask();
+
+  return option;
+}
+
 std::unique_ptr<LogSoftmaxOptions> Model::MakeLogSoftmaxOptions(
     const tflite::Operator*) {
   std::unique_ptr<LogSoftmaxOptions> option =
@@ -803,13 +908,64 @@ std::unique_ptr<BuiltinOptions> Model::HandleBuiltinOptions(
       return MakeSequenceRNNOptions(op);
       break;
 
+    case tflite::BuiltinOptions_StridedSliceOptions:
+      return MakeStridedSliceOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_ExpOptions:
+      return MakeExpOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_TopKV2Options:
+      return MakeTopKV2Options(op);
+      break;
+
+    case tflite::BuiltinOptions_SplitOptions:
+      return MakeSplitOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_LogSoftmaxOptions:
+      return MakeLogSoftmaxOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_CastOptions:
+      return MakeCastOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_DequantizeOptions:
+      return MakeDequantizeOptions(op);
+      break;
+
+#ifdef NEWER_TENSORFLOW
+    case tflite::BuiltinOptions_MaximumMinimumOptions:
+      return MakeMaximumMinimumOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_ArgMaxOptions:
+      return MakeArgMaxOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_LessOptions:
+      return MakeLessOptions(op);
+      break;
+
+    case tflite::BuiltinOptions_NegOptions:
+      return MakeNegOptions(op);
+      break;
+#else
+    case tflite::BuiltinOptions_MaximumOptions:
+      return MakeMaximumOptions(op);
+      break;
+#endif
+
     default:
       return MakeNoneOptions(op);
   }
 }
 
-void Model::PopulateGraphOperators(const tflite::SubGraph* graph) {
-  auto operators = graph->operators();
+void Model::PopulateGraphOperators(const tflite::SubGraph* fb_graph,
+    Graph& graph) {
+  auto operators = fb_graph->operators();
   std::vector<Operator> vec_operators;
 
   // get operators
@@ -827,7 +983,7 @@ void Model::PopulateGraphOperators(const tflite::SubGraph* graph) {
     size_t opcode_index = static_cast<size_t>(it->opcode_index());
     const OperatorCode& op_code = operators_code_[opcode_index];
 
-    graph_.AddOperator(Operator(opcode_index, op_code, std::move(builtin_op),
+    graph.AddOperator(Operator(opcode_index, op_code, std::move(builtin_op),
         opt_str, std::move(vec_ins), std::move(vec_outs)));
   }
 }
@@ -839,17 +995,30 @@ void Model::PopulateGraph() {
   }
 
   auto subgraphs = fb_model_->subgraphs();
-  if (!subgraphs) {
+  if (!subgraphs || subgraphs->size() == 0) {
     FATAL("No subgraph found")
     return;
   }
 
-  auto graph = subgraphs->Get(0);
+  // the graphs are not moved after this, so references to them stay valid
+  graphs_.resize(subgraphs->size());
+
+  for (size_t i = 0; i < subgraphs->size(); i++) {
+    auto fb_graph = subgraphs->Get(i);
+
+    PopulateGraphInputs(fb_graph, graphs_[i]);
+    PopulateGraphOutputs(fb_graph, graphs_[i]);
+    PopulateGraphTensors(fb_graph, graphs_[i]);
+    PopulateGraphOperators(fb_graph, graphs_[i]);
+  }
+}
+
+uint Model::AddBuffer(std::vector<u_char>&& data) {
+  owned_data_.push_back(std::move(data));
+  const std::vector<u_char>& owned = owned_data_.back();
 
-  PopulateGraphInputs(graph);
-  PopulateGraphOutputs(graph);
-  PopulateGraphTensors(graph);
-  PopulateGraphOperators(graph);
+  buffers_.push_back(Buffer(owned.data(), owned.size()));
+  return buffers_.size() - 1;
 }
 
 void Model::PopulateBuffers() {
@@ -860,9 +1029,16 @@ void Model::PopulateBuffers() {
     return;
   }
 
+  // buffers only point to the data inside the flatbuffer, so the weights
+  // are not copied
   for (auto it = buffer_vec->begin(); it != buffer_vec->end(); ++it) {
-    std::vector<u_char> buf = AssignVector<u_char>(it->data());
-    buffers_.push_back(std::move(buf));
+    auto data = it->data();
+
+    if (data) {
+      buffers_.push_back(Buffer(data->data(), data->size()));
+    } else {
+      buffers_.push_back(Buffer(nullptr, 0));
+    }
   }
 }
 
@@ -1124,6 +1300,612 @@ void Model::PopulateOperatorsCode() {
   }
 }
 
+size_t TensorTypeSize(TensorType type) {
+  switch (type) {
+    case TensorType::FLOAT32:
+    case TensorType::INT32:
+      return 4;
+      break;
+
+    case TensorType::FLOAT16:
+      return 2;
+      break;
+
+    case TensorType::INT64:
+      return 8;
+      break;
+
+    default:
+      return 1;
+  }
+}
+
+size_t NumElements(const std::vector<int>& shape) {
+  size_t count = 1;
+
+  for (int dim : shape) {
+    count *= static_cast<size_t>(dim);
+  }
+
+  return count;
+}
+
+size_t TensorByteSize(const Tensor& tensor) {
+  return TensorTypeSize(tensor.tensor_type()) * NumElements(tensor.shape());
+}
+
+int SamePadding(int in_size, int out_size, int filter_size, int stride,
+    int dilation, Padding padding) {
+  if (padding != Padding::SAME) {
+    return 0;
+  }
+
+  int effective_filter = (filter_size - 1) * dilation + 1;
+  int total = (out_size - 1) * stride + effective_filter - in_size;
+
+  return total > 0 ? total / 2 : 0;
+}
+
+float HalfToFloat(uint16_t half) {
+  uint32_t sign = uint32_t(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+  uint32_t bits;
+
+  if (exponent == 0x1f) {
+    // infinity and nan
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // subnormal half, normal on float
+    exponent = 127 - 14;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      exponent--;
+    }
+
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t abs = bits & 0x7fffffff;
+
+  // infinity and nan, a nan stays a nan
+  if (abs >= 0x7f800000) {
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+
+  // 65520 and above round to infinity
+  if (abs >= 0x477ff000) {
+    return sign | 0x7c00;
+  }
+
+  // below 2^-14 the half is subnormal, in steps of 2^-24
+  if (abs < 0x38800000) {
+    float magnitude;
+    std::memcpy(&magnitude, &abs, sizeof(magnitude));
+    return sign | static_cast<uint16_t>(std::nearbyint(
+        magnitude * 16777216.0f));
+  }
+
+  // a carry of the rounding goes to the exponent, as it should
+  uint32_t half = (abs >> 13) - ((127 - 15) << 10);
+  uint32_t rest = abs & 0x1fff;
+
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    ++half;
+  }
+
+  return sign | half;
+}
+
+ActivationFunctionType* FusedActivation(Operator& op) {
+  BuiltinOptions& options = op.builtin_op();
+
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::CONV_2D:
+      if (options.type == BuiltinOptionsType::Conv2DOptions) {
+        return &static_cast<Conv2DOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::DEPTHWISE_CONV_2D:
+      if (options.type == BuiltinOptionsType::DepthwiseConv2DOptions) {
+        return &static_cast<DepthwiseConv2DOptions&>(
+            options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::FULLY_CONNECTED:
+      if (options.type == BuiltinOptionsType::FullyConnectedOptions) {
+        return &static_cast<FullyConnectedOptions&>(
+            options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::AVERAGE_POOL_2D:
+    case BuiltinOperator::MAX_POOL_2D:
+    case BuiltinOperator::L2_POOL_2D:
+      if (options.type == BuiltinOptionsType::Pool2DOptions) {
+        return &static_cast<Pool2DOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::CONCATENATION:
+      if (options.type == BuiltinOptionsType::ConcatenationOptions) {
+        return &static_cast<ConcatenationOptions&>(
+            options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::ADD:
+      if (options.type == BuiltinOptionsType::AddOptions) {
+        return &static_cast<AddOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::SUB:
+      if (options.type == BuiltinOptionsType::SubOptions) {
+        return &static_cast<SubOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::MUL:
+      if (options.type == BuiltinOptionsType::MulOptions) {
+        return &static_cast<MulOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    case BuiltinOperator::DIV:
+      if (options.type == BuiltinOptionsType::DivOptions) {
+        return &static_cast<DivOptions&>(options).fused_activation_function;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return nullptr;
+}
+
+// fields of each type of options, on the order they are declared
+static std::tuple<> OptionsFields(const NoneOptions&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const Conv2DOptions& o) {
+#ifdef NEWER_TENSORFLOW
+  return std::tie(o.padding, o.stride_w, o.stride_h, o.dilation_w_factor,
+      o.dilation_h_factor, o.fused_activation_function);
+#else
+  return std::tie(o.padding, o.stride_w, o.stride_h,
+      o.fused_activation_function);
+#endif
+}
+
+static auto OptionsFields(const DepthwiseConv2DOptions& o) {
+  return std::tie(o.padding, o.stride_w, o.stride_h, o.depth_multiplier,
+      o.fused_activation_function);
+}
+
+static auto OptionsFields(const ConcatEmbeddingsOptions& o) {
+  return std::tie(o.num_channels, o.num_columns_per_channel,
+      o.embedding_dim_per_channel);
+}
+
+static auto OptionsFields(const LSHProjectionOptions& o) {
+  return std::tie(o.type);
+}
+
+static auto OptionsFields(const Pool2DOptions& o) {
+  return std::tie(o.padding, o.stride_w, o.stride_h, o.filter_width,
+      o.filter_height, o.fused_activation_function);
+}
+
+static auto OptionsFields(const SVDFOptions& o) {
+  return std::tie(o.rank, o.fused_activation_function);
+}
+
+static auto OptionsFields(const RNNOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const FullyConnectedOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const SoftmaxOptions& o) {
+  return std::tie(o.beta);
+}
+
+static auto OptionsFields(const ConcatenationOptions& o) {
+  return std::tie(o.axis, o.fused_activation_function);
+}
+
+static auto OptionsFields(const AddOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const L2NormOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const LocalResponseNormalizationOptions& o) {
+  return std::tie(o.radius, o.bias, o.alpha, o.beta);
+}
+
+static auto OptionsFields(const LSTMOptions& o) {
+  return std::tie(o.cell_clip, o.proj_clip, o.fused_activation_function);
+}
+
+static auto OptionsFields(const ResizeBilinearOptions& o) {
+  return std::tie(o.align_corners);
+}
+
+static auto OptionsFields(const CallOptions& o) {
+  return std::tie(o.subgraph);
+}
+
+static auto OptionsFields(const ReshapeOptions& o) {
+  return std::tie(o.new_shape);
+}
+
+static auto OptionsFields(const SkipGramOptions& o) {
+  return std::tie(o.ngram_size, o.max_skip_size, o.include_all_ngrams);
+}
+
+static auto OptionsFields(const SpaceToDepthOptions& o) {
+  return std::tie(o.block_size);
+}
+
+static auto OptionsFields(const EmbeddingLookupSparseOptions& o) {
+  return std::tie(o.combiner);
+}
+
+static auto OptionsFields(const MulOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static std::tuple<> OptionsFields(const PadOptions&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const GatherOptions& o) {
+  return std::tie(o.axis);
+}
+
+static std::tuple<> OptionsFields(const BatchToSpaceNDOptions&) {
+  return std::tuple<>();
+}
+
+static std::tuple<> OptionsFields(const SpaceToBatchNDOptions&) {
+  return std::tuple<>();
+}
+
+static std::tuple<> OptionsFields(const TransposeOptions&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const MeanOptions& o) {
+  return std::tie(o.keep_dims);
+}
+
+static auto OptionsFields(const SubOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const DivOptions& o) {
+  return std::tie(o.fused_activation_function);
+}
+
+static auto OptionsFields(const SqueezeOptions& o) {
+  return std::tie(o.squeeze_dims);
+}
+
+static auto OptionsFields(const SequenceRNNOptions& o) {
+  return std::tie(o.time_major, o.fused_activation_function);
+}
+
+static auto OptionsFields(const StridedSliceOptions& o) {
+  return std::tie(o.begin_mask, o.end_mask, o.ellipsis_mask, o.new_axis_mask,
+      o.shrink_axis_mask);
+}
+
+static std::tuple<> OptionsFields(const ExpOptions&) {
+  return std::tuple<>();
+}
+
+static std::tuple<> OptionsFields(const TopKV2Options&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const SplitOptions& o) {
+  return std::tie(o.num_splits);
+}
+
+static std::tuple<> OptionsFields(const LogSoftmaxOptions&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const CastOptions& o) {
+  return std::tie(o.in_data_type, o.out_data_type);
+}
+
+static std::tuple<> OptionsFields(const DequantizeOptions&) {
+  return std::tuple<>();
+}
+
+#ifdef NEWER_TENSORFLOW
+static std::tuple<> OptionsFields(const MaximumMinimumOptions&) {
+  return std::tuple<>();
+}
+
+static auto OptionsFields(const ArgMaxOptions& o) {
+  return std::tie(o.output_type);
+}
+
+static std::tuple<> OptionsFields(const LessOptions&) {
+  return std::tuple<>();
+}
+
+static std::tuple<> OptionsFields(const NegOptions&) {
+  return std::tuple<>();
+}
+#else
+static std::tuple<> OptionsFields(const MaximumOptions&) {
+  return std::tuple<>();
+}
+#endif
+
+// calls fn with the options cast to the type they have
+template<class Fn>
+static auto VisitOptions(const BuiltinOptions& options, Fn fn) {
+  switch (options.type) {
+    case BuiltinOptionsType::Conv2DOptions:
+      return fn(static_cast<const Conv2DOptions&>(options));
+
+    case BuiltinOptionsType::DepthwiseConv2DOptions:
+      return fn(static_cast<const DepthwiseConv2DOptions&>(options));
+
+    case BuiltinOptionsType::ConcatEmbeddingsOptions:
+      return fn(static_cast<const ConcatEmbeddingsOptions&>(options));
+
+    case BuiltinOptionsType::LSHProjectionOptions:
+      return fn(static_cast<const LSHProjectionOptions&>(options));
+
+    case BuiltinOptionsType::Pool2DOptions:
+      return fn(static_cast<const Pool2DOptions&>(options));
+
+    case BuiltinOptionsType::SVDFOptions:
+      return fn(static_cast<const SVDFOptions&>(options));
+
+    case BuiltinOptionsType::RNNOptions:
+      return fn(static_cast<const RNNOptions&>(options));
+
+    case BuiltinOptionsType::FullyConnectedOptions:
+      return fn(static_cast<const FullyConnectedOptions&>(options));
+
+    case BuiltinOptionsType::SoftmaxOptions:
+      return fn(static_cast<const SoftmaxOptions&>(options));
+
+    case BuiltinOptionsType::ConcatenationOptions:
+      return fn(static_cast<const ConcatenationOptions&>(options));
+
+    case BuiltinOptionsType::AddOptions:
+      return fn(static_cast<const AddOptions&>(options));
+
+    case BuiltinOptionsType::L2NormOptions:
+      return fn(static_cast<const L2NormOptions&>(options));
+
+    case BuiltinOptionsType::LocalResponseNormalizationOptions:
+      return fn(static_cast<const LocalResponseNormalizationOptions&>(options));
+
+    case BuiltinOptionsType::LSTMOptions:
+      return fn(static_cast<const LSTMOptions&>(options));
+
+    case BuiltinOptionsType::ResizeBilinearOptions:
+      return fn(static_cast<const ResizeBilinearOptions&>(options));
+
+    case BuiltinOptionsType::CallOptions:
+      return fn(static_cast<const CallOptions&>(options));
+
+    case BuiltinOptionsType::ReshapeOptions:
+      return fn(static_cast<const ReshapeOptions&>(options));
+
+    case BuiltinOptionsType::SkipGramOptions:
+      return fn(static_cast<const SkipGramOptions&>(options));
+
+    case BuiltinOptionsType::SpaceToDepthOptions:
+      return fn(static_cast<const SpaceToDepthOptions&>(options));
+
+    case BuiltinOptionsType::EmbeddingLookupSparseOptions:
+      return fn(static_cast<const EmbeddingLookupSparseOptions&>(options));
+
+    case BuiltinOptionsType::MulOptions:
+      return fn(static_cast<const MulOptions&>(options));
+
+    case BuiltinOptionsType::PadOptions:
+      return fn(static_cast<const PadOptions&>(options));
+
+    case BuiltinOptionsType::GatherOptions:
+      return fn(static_cast<const GatherOptions&>(options));
+
+    case BuiltinOptionsType::BatchToSpaceNDOptions:
+      return fn(static_cast<const BatchToSpaceNDOptions&>(options));
+
+    case BuiltinOptionsType::SpaceToBatchNDOptions:
+      return fn(static_cast<const SpaceToBatchNDOptions&>(options));
+
+    case BuiltinOptionsType::TransposeOptions:
+      return fn(static_cast<const TransposeOptions&>(options));
+
+    case BuiltinOptionsType::MeanOptions:
+      return fn(static_cast<const MeanOptions&>(options));
+
+    case BuiltinOptionsType::SubOptions:
+      return fn(static_cast<const SubOptions&>(options));
+
+    case BuiltinOptionsType::DivOptions:
+      return fn(static_cast<const DivOptions&>(options));
+
+    case BuiltinOptionsType::SqueezeOptions:
+      return fn(static_cast<const SqueezeOptions&>(options));
+
+    case BuiltinOptionsType::SequenceRNNOptions:
+      return fn(static_cast<const SequenceRNNOptions&>(options));
+
+    case BuiltinOptionsType::StridedSliceOptions:
+      return fn(static_cast<const StridedSliceOptions&>(options));
+
+    case BuiltinOptionsType::ExpOptions:
+      return fn(static_cast<const ExpOptions&>(options));
+
+    case BuiltinOptionsType::TopKV2Options:
+      return fn(static_cast<const TopKV2Options&>(options));
+
+    case BuiltinOptionsType::SplitOptions:
+      return fn(static_cast<const SplitOptions&>(options));
+
+    case BuiltinOptionsType::LogSoftmaxOptions:
+      return fn(static_cast<const LogSoftmaxOptions&>(options));
+
+    case BuiltinOptionsType::CastOptions:
+      return fn(static_cast<const CastOptions&>(options));
+
+    case BuiltinOptionsType::DequantizeOptions:
+      return fn(static_cast<const DequantizeOptions&>(options));
+
+#ifdef NEWER_TENSORFLOW
+    case BuiltinOptionsType::MaximumMinimumOptions:
+      return fn(static_cast<const MaximumMinimumOptions&>(options));
+
+    case BuiltinOptionsType::ArgMaxOptions:
+      return fn(static_cast<const ArgMaxOptions&>(options));
+
+    case BuiltinOptionsType::LessOptions:
+      return fn(static_cast<const LessOptions&>(options));
+
+    case BuiltinOptionsType::NegOptions:
+      return fn(static_cast<const NegOptions&>(options));
+#else
+    case BuiltinOptionsType::MaximumOptions:
+      return fn(static_cast<const MaximumOptions&>(options));
+#endif
+
+    default:
+      return fn(static_cast<const NoneOptions&>(options));
+  }
+}
+
+size_t BuiltinOptionsHash(const BuiltinOptions& options) {
+  return VisitOptions(options, [&options](const auto& typed) {
+    size_t seed = static_cast<size_t>(options.type);
+
+    std::apply([&seed](const auto&... fields) {
+      (boost::hash_combine(seed, fields), ...);
+    }, OptionsFields(typed));
+
+    return seed;
+  });
+}
+
+bool BuiltinOptionsEqual(const BuiltinOptions& a, const BuiltinOptions& b) {
+  if (a.type != b.type) {
+    return false;
+  }
+
+  return VisitOptions(a, [&b](const auto& typed) {
+    using T = std::decay_t<decltype(typed)>;
+    return OptionsFields(typed) == OptionsFields(static_cast<const T&>(b));
+  });
+}
+
+std::unique_ptr<BuiltinOptions> CloneBuiltinOptions(
+    const BuiltinOptions& options) {
+  return VisitOptions(options, [](const auto& typed) {
+    using T = std::decay_t<decltype(typed)>;
+    return std::unique_ptr<BuiltinOptions>(std::make_unique<T>(typed));
+  });
+}
+
+void Graph::ReorderOperators(const std::vector<int>& order) {
+  if (order.size() != operators_.size()) {
+    FATAL(boost::format("Operators order has %1% entries, graph has %2% "
+        "operators")%order.size()%operators_.size())
+  }
+
+  std::vector<Operator> operators;
+  operators.reserve(operators_.size());
+
+  for (int i : order) {
+    operators.push_back(std::move(operators_[i]));
+  }
+
+  operators_ = std::move(operators);
+}
+
+void Graph::RemoveOperators(const std::vector<bool>& removed) {
+  std::vector<Operator> operators;
+
+  for (size_t i = 0; i < operators_.size(); i++) {
+    if (i >= removed.size() || !removed[i]) {
+      operators.push_back(std::move(operators_[i]));
+    }
+  }
+
+  operators_ = std::move(operators);
+}
+
+void Graph::RemoveTensors(const std::vector<bool>& removed) {
+  std::vector<int> new_index(tensors_.size(), -1);
+  std::vector<Tensor> tensors;
+
+  for (size_t i = 0; i < tensors_.size(); i++) {
+    if (i >= removed.size() || !removed[i]) {
+      new_index[i] = tensors.size();
+      tensors.push_back(std::move(tensors_[i]));
+    }
+  }
+
+  // optional tensors keep the -1 index
+  auto renumber = [&new_index](const std::vector<int>& indexes) {
+    std::vector<int> renumbered;
+    renumbered.reserve(indexes.size());
+
+    for (int i : indexes) {
+      if (i >= 0 && new_index[i] < 0) {
+        FATAL(boost::format("Tensor %1% removed but still in use")%i)
+      }
+
+      renumbered.push_back(i < 0 ? i : new_index[i]);
+    }
+
+    return renumbered;
+  };
+
+  for (auto& op : operators_) {
+    op.SetInputs(renumber(op.inputs()));
+    op.SetOutputs(renumber(op.outputs()));
+  }
+
+  inputs_ = renumber(inputs_);
+  outputs_ = renumber(outputs_);
+  tensors_ = std::move(tensors);
+}
+
 const char* Model::description() {
   return fb_model_->description()->c_str();
 }
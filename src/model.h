@@ -3,40 +3,72 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <memory>
 #include <cuchar>
+#include <cstring>
 #include <boost/variant.hpp>
 
 #include "schemas/schema_generated.h"
 
 namespace nnt {
 
+// Holds the raw flatbuffer of a model. By default the file is memory
+// mapped read-only, so the weights are paged in on demand and never copied,
+// when mmap is disabled or not available the file is read into the heap.
 class FlatBufferModel {
  public:
-  FlatBufferModel(const std::string& file);
+  FlatBufferModel(const std::string& file, bool use_mmap = true);
   ~FlatBufferModel();
-  char* data();
-  int Length() const;
+
+  FlatBufferModel(const FlatBufferModel&) = delete;
+  FlatBufferModel& operator=(const FlatBufferModel&) = delete;
+
+  const char* data() const;
+  size_t Length() const;
+
+  bool IsMapped() const {
+    return mapped_;
+  }
 
  private:
+  bool MapFile(int fd, size_t length);
+  void ReadFile(int fd, size_t length);
+
   char *data_;
-  int len_;
+  size_t len_;
+  bool mapped_;
 };
 
+// Non-owning view of a constant buffer of the model, the memory belongs to
+// the FlatBufferModel, so a Buffer must not outlive its Model.
 class Buffer {
  public:
-  Buffer(std::vector<u_char>&& buf): buf_(std::move(buf)) {}
+  Buffer(const u_char* data, size_t size): data_(data), size_(size) {}
 
-  const std::vector<u_char>& Data() const {
-    return buf_;
+  const u_char* RawData() const {
+    return data_;
   }
 
-  const u_char* RawData() const {
-    return buf_.data();
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  const u_char* begin() const {
+    return data_;
+  }
+
+  const u_char* end() const {
+    return data_ + size_;
   }
 
  private:
-  std::vector<u_char> buf_;
+  const u_char* data_;
+  size_t size_;
 };
 
 enum class ActivationFunctionType: int8_t {
@@ -55,6 +87,7 @@ enum class TensorType: int8_t {
   UINT8,
   INT64,
   STRING,
+  INT8,
 #ifdef NEWER_TENSORFLOW
   BOOL
 #endif
@@ -532,10 +565,22 @@ class Operator {
     return outputs_;
   }
 
+  void SetInputs(std::vector<int>&& inputs) {
+    inputs_ = std::move(inputs);
+  }
+
+  void SetOutputs(std::vector<int>&& outputs) {
+    outputs_ = std::move(outputs);
+  }
+
   const BuiltinOptions& builtin_op() const {
     return *builtin_op_;
   }
 
+  BuiltinOptions& builtin_op() {
+    return *builtin_op_;
+  }
+
   const OperatorCode& op_code() const {
     return op_code_;
   }
@@ -554,6 +599,14 @@ struct QuantizationParameters {
   std::vector<float> max;
   std::vector<float> scale;
   std::vector<long> zero_point;
+
+  // dimension of the shape indexed by the scales of a per-channel tensor
+  int quantized_dimension = 0;
+
+  // one scale for each index along quantized_dimension
+  bool PerChannel() const {
+    return scale.size() > 1;
+  }
 };
 
 class Tensor {
@@ -564,7 +617,7 @@ class Tensor {
     : shape_(std::move(shape))
     , tensor_type_(tensor_type)
     , name_(name)
-    , buffer_(buffer)
+    , buffer_(&buffer)
     , buffer_index_(buffer_index)
     , quantization_(std::move(quantization)) {}
 
@@ -586,12 +639,30 @@ class Tensor {
     return shape_;
   }
 
+  // the shape inference fills the shapes left unknown by the file
+  void SetShape(std::vector<int>&& shape) {
+    shape_ = std::move(shape);
+  }
+
   TensorType tensor_type() const {
     return tensor_type_;
   }
 
+  // the quantization changes the type of float tensors, together with
+  // their buffer and quantization parameters
+  void SetTensorType(TensorType tensor_type) {
+    tensor_type_ = tensor_type;
+  }
+
   const Buffer& buffer() const {
-    return buffer_;
+    return *buffer_;
+  }
+
+  // binds the tensor to another buffer of the model, e.g. when its value
+  // is computed at transpile time
+  void SetBuffer(const Buffer& buffer, uint buffer_index) {
+    buffer_ = &buffer;
+    buffer_index_ = buffer_index;
   }
 
   uint buffer_index() const {
@@ -606,15 +677,64 @@ class Tensor {
     return *quantization_;
   }
 
+  QuantizationParameters& quantization() {
+    return *quantization_;
+  }
+
+  void SetQuantization(std::unique_ptr<QuantizationParameters> quantization) {
+    quantization_ = std::move(quantization);
+  }
+
  private:
   std::vector<int> shape_;
   TensorType tensor_type_;
   std::string name_;
-  const Buffer& buffer_;
+  const Buffer* buffer_;
   uint buffer_index_;
   std::unique_ptr<QuantizationParameters> quantization_;
 };
 
+// Size in bytes of one element of the given tensor type
+size_t TensorTypeSize(TensorType type);
+
+// Number of elements of a shape, computed in 64 bits
+size_t NumElements(const std::vector<int>& shape);
+
+// Size in bytes of the whole tensor, computed in 64 bits
+size_t TensorByteSize(const Tensor& tensor);
+
+// Elements of a buffer as T, they are copied because the data on the
+// flatbuffer is not guaranteed to be aligned
+template<class T>
+std::vector<T> ReadBuffer(const Buffer& buffer) {
+  std::vector<T> values(buffer.Size() / sizeof(T));
+  std::memcpy(values.data(), buffer.RawData(), values.size() * sizeof(T));
+  return values;
+}
+
+// Padding before the first element of a window with SAME padding, the
+// extra element of an odd total goes after the last one, 0 for VALID
+int SamePadding(int in_size, int out_size, int filter_size, int stride,
+    int dilation, Padding padding);
+
+// IEEE half precision conversions, float to half rounds to the nearest even
+// and overflows to infinity
+float HalfToFloat(uint16_t half);
+uint16_t FloatToHalf(float value);
+
+// Field fused_activation_function of the options of the operator, or
+// nullptr if the operator can't have a fused activation
+ActivationFunctionType* FusedActivation(Operator& op);
+
+// Structural hash and equality of the options of operators, field by field.
+// Options of different types are never equal.
+size_t BuiltinOptionsHash(const BuiltinOptions& options);
+bool BuiltinOptionsEqual(const BuiltinOptions& a, const BuiltinOptions& b);
+
+// Copy of the options with the type they have
+std::unique_ptr<BuiltinOptions> CloneBuiltinOptions(
+    const BuiltinOptions& options);
+
 class Graph {
  public:
   Graph() = default;
@@ -635,14 +755,35 @@ class Graph {
     operators_.push_back(std::move(op));
   }
 
+  // order[i] is the position on the current list of the operator that
+  // goes to position i
+  void ReorderOperators(const std::vector<int>& order);
+
+  // removes the operators marked on the vector, keeping the order of the
+  // others
+  void RemoveOperators(const std::vector<bool>& removed);
+
+  // removes the tensors marked on the vector and renumbers the others, the
+  // references on the operators and on the graph inputs and outputs are
+  // updated to the new indexes
+  void RemoveTensors(const std::vector<bool>& removed);
+
   const std::vector<Tensor>& Tensors() const {
     return tensors_;
   }
 
+  std::vector<Tensor>& Tensors() {
+    return tensors_;
+  }
+
   const std::vector<Operator>& Operators() const {
     return operators_;
   }
 
+  std::vector<Operator>& Operators() {
+    return operators_;
+  }
+
   const std::vector<int>& Inputs() const {
     return inputs_;
   }
@@ -660,30 +801,46 @@ class Graph {
 
 class Model {
  public:
-  Model(const std::string& file);
+  Model(const std::string& file, bool use_mmap = true);
 
   const char* description();
 
+  // the main graph, subgraph 0 of the file
   Graph& graph() {
-    return graph_;
+    return graphs_[0];
   }
 
-  const std::vector<Buffer>& Buffers() const {
+  // every subgraph of the file, the others are only reached by CALL
+  // operators
+  Graph& graph(size_t index) {
+    return graphs_[index];
+  }
+
+  size_t NumGraphs() const {
+    return graphs_.size();
+  }
+
+  const std::deque<Buffer>& Buffers() const {
     return buffers_;
   }
 
+  // adds a buffer owned by the model, the references to the buffers already
+  // on the model stay valid, returns the index of the new buffer
+  uint AddBuffer(std::vector<u_char>&& data);
+
  private:
   void PopulateGraph();
 
-  void PopulateGraphInputs(const tflite::SubGraph* graph);
+  void PopulateGraphInputs(const tflite::SubGraph* fb_graph, Graph& graph);
 
-  void PopulateGraphOutputs(const tflite::SubGraph* graph);
+  void PopulateGraphOutputs(const tflite::SubGraph* fb_graph, Graph& graph);
 
   TensorType ConvertTensorType(tflite::TensorType type);
 
-  void PopulateGraphTensors(const tflite::SubGraph* graph);
+  void PopulateGraphTensors(const tflite::SubGraph* fb_graph, Graph& graph);
 
-  void PopulateGraphOperators(const tflite::SubGraph* graph);
+  void PopulateGraphOperators(const tflite::SubGraph* fb_graph,
+      Graph& graph);
 
   void PopulateBuffers();
 
@@ -786,6 +943,9 @@ class Model {
 
   std::unique_ptr<SplitOptions> MakeSplitOptions(const tflite::Operator* op);
 
+  std::unique_ptr<StridedSliceOptions> MakeStridedSliceOptions(
+      const tflite::Operator* op);
+
   std::unique_ptr<LogSoftmaxOptions> MakeLogSoftmaxOptions(
       const tflite::Operator* op);
 
@@ -813,9 +973,12 @@ class Model {
 
   FlatBufferModel flat_buffers_;
   const tflite::Model *fb_model_;
-  std::vector<Buffer> buffers_;
+  std::deque<Buffer> buffers_;
+
+  // data of the buffers created after the model was loaded
+  std::deque<std::vector<u_char>> owned_data_;
   std::vector<OperatorCode> operators_code_;
-  Graph graph_;
+  std::vector<Graph> graphs_;
 };
 
 template<class T, class Ptr>
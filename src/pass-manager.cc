@@ -0,0 +1,134 @@
+#include "pass-manager.h"
+
+#include <chrono>
+#include <iostream>
+#include <boost/format.hpp>
+
+#include "activation-fusion.h"
+#include "affine-folding.h"
+#include "common-subexpression-elimination.h"
+#include "constant-folding.h"
+#include "dead-code-elimination.h"
+#include "reshape-elimination.h"
+#include "scheduler.h"
+#include "shape-inference.h"
+#include "exception.h"
+
+namespace nnt {
+
+using Clock = std::chrono::steady_clock;
+
+static double Seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void PassManager::Add(const std::string& name, Pass pass) {
+  Entry entry;
+  entry.name = name;
+  entry.pass = std::move(pass);
+  passes_.push_back(std::move(entry));
+}
+
+void PassManager::AddLevel(int level) {
+  if (level < 0 || level > kMaxLevel) {
+    FATAL(boost::format("Optimization level %1% not supported") % level)
+  }
+
+  // not an optimization, every level needs the shapes to size the tensors
+  Add("shape-inference", [](Model& model, const GraphIndex&) {
+    return ShapeInference(model.graph()).Run();
+  });
+
+  if (level >= 1) {
+    Add("constant-folding", [](Model& model, const GraphIndex& index) {
+      return ConstantFolding(model, index).Run();
+    });
+
+    // once a duplicated branch is merged, its tensors have a single reader
+    // again, as the folding and fusion passes require
+    Add("common-subexpression-elimination",
+        [](Model& model, const GraphIndex& index) {
+          return CommonSubexpressionElimination(model.graph(), index).Run();
+        });
+
+    // before the activation fusion, that would put an activation between
+    // the operator and the MUL or ADD
+    Add("affine-folding", [](Model& model, const GraphIndex& index) {
+      return AffineFolding(model, index).Run();
+    });
+
+    Add("activation-fusion", [](Model& model, const GraphIndex& index) {
+      return ActivationFusion(model.graph(), index).Run();
+    });
+
+    Add("reshape-elimination", [](Model& model, const GraphIndex& index) {
+      return ReshapeElimination(model.graph(), index).Run();
+    });
+
+    // the passes before leave tensors without readers behind
+    Add("dead-code-elimination", [](Model& model, const GraphIndex&) {
+      DeadCodeElimination dce(model.graph());
+      dce.Run();
+      return dce.RemovedOperators() + dce.RemovedTensors();
+    });
+  }
+
+  if (level >= 2) {
+    Add("scheduler", [](Model& model, const GraphIndex&) {
+      Scheduler scheduler(model.graph());
+      size_t before = scheduler.PeakMemory();
+      bool changed = scheduler.Run();
+      size_t after = scheduler.PeakMemory();
+
+      std::cout << "Peak memory of activations: " << before << " bytes "
+                << "before scheduling, " << after << " bytes after\n";
+      return changed ? 1 : 0;
+    });
+  }
+}
+
+const GraphIndex& PassManager::Index() {
+  if (!index_) {
+    Clock::time_point start = Clock::now();
+    index_ = std::make_unique<GraphIndex>(model_.graph());
+    index_seconds_ += Seconds(start);
+    ++index_builds_;
+  }
+
+  return *index_;
+}
+
+void PassManager::Run() {
+  for (auto& entry : passes_) {
+    const GraphIndex& index = Index();
+
+    Clock::time_point start = Clock::now();
+    int changes = entry.pass(model_, index);
+    entry.seconds += Seconds(start);
+    entry.changes += changes;
+
+    if (changes > 0) {
+      Invalidate();
+    }
+  }
+}
+
+std::string PassManager::Report() const {
+  boost::format line(" %1$-32s %2$6s %3$-7s %4$10.3f ms\n");
+  std::string str_report = "::Passes::\n";
+  double total = index_seconds_;
+
+  for (const auto& entry : passes_) {
+    str_report += boost::str(line % entry.name % entry.changes % "changes" %
+        (entry.seconds * 1000));
+    total += entry.seconds;
+  }
+
+  str_report += boost::str(line % "graph-index" % index_builds_ % "builds" %
+      (index_seconds_ * 1000));
+  str_report += boost::str(line % "total" % "" % "" % (total * 1000));
+
+  return str_report;
+}
+
+}
@@ -0,0 +1,67 @@
+#ifndef NNT_PASS_MANAGER_H
+#define NNT_PASS_MANAGER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "graph-index.h"
+
+namespace nnt {
+
+// Runs a pipeline of passes over the graph of a model. The passes share the
+// def-use index of the graph, it is built when a pass needs it and dropped
+// after a pass that changed the graph, so a pass never sees an index older
+// than the graph and the unchanged graphs don't pay for a new one. The
+// number of changes and the time of each pass are kept for the report.
+class PassManager {
+ public:
+  // a pass returns the number of changes it made, 0 means the graph is the
+  // same and the index is still valid
+  using Pass = std::function<int(Model&, const GraphIndex&)>;
+
+  static constexpr int kMaxLevel = 2;
+
+  PassManager(Model& model): model_(model), index_builds_(0),
+      index_seconds_(0) {}
+
+  void Add(const std::string& name, Pass pass);
+
+  // adds the passes of an optimization level: 0 only infers the shapes, 1
+  // also runs the passes that simplify the graph and 2 also reorders the
+  // operators to reduce the peak memory
+  void AddLevel(int level);
+
+  void Run();
+
+  // index of the current graph, built again if the graph changed
+  const GraphIndex& Index();
+
+  // must be called by code that changes the graph outside of a pass
+  void Invalidate() {
+    index_.reset();
+  }
+
+  // changes and time of each pass that already ran
+  std::string Report() const;
+
+ private:
+  struct Entry {
+    std::string name;
+    Pass pass;
+    int changes = 0;
+    double seconds = 0;
+  };
+
+  Model& model_;
+  std::vector<Entry> passes_;
+  std::unique_ptr<GraphIndex> index_;
+  int index_builds_;
+  double index_seconds_;
+};
+
+}
+
+#endif  // NNT_PASS_MANAGER_H
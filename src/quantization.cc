@@ -0,0 +1,333 @@
+#include "quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+
+#include "interpreter.h"
+#include "exception.h"
+
+namespace nnt {
+
+static bool IsFloat(const Tensor& tensor) {
+  return tensor.tensor_type() == TensorType::FLOAT32;
+}
+
+// root of the group of the tensor, the path is compressed on the way
+static int FindGroup(std::vector<int>& group, int index) {
+  while (group[index] != index) {
+    group[index] = group[group[index]];
+    index = group[index];
+  }
+
+  return index;
+}
+
+static void JoinGroups(std::vector<int>& group, int a, int b) {
+  group[FindGroup(group, a)] = FindGroup(group, b);
+}
+
+static std::unique_ptr<QuantizationParameters> FixedQuantization(
+    float scale, long zero_point) {
+  auto quant = std::make_unique<QuantizationParameters>();
+  quant->scale.push_back(scale);
+  quant->zero_point.push_back(zero_point);
+  quant->min.push_back((0 - zero_point) * scale);
+  quant->max.push_back((255 - zero_point) * scale);
+
+  return quant;
+}
+
+std::vector<std::string> Quantization::CalibrationFiles() {
+  namespace fs = boost::filesystem;
+  fs::path path(calibration_path_);
+
+  if (!fs::is_directory(path)) {
+    FATAL(boost::format("Calibration path '%1%' is not a directory")
+        %calibration_path_)
+  }
+
+  std::vector<std::string> files;
+  for (const auto& entry : fs::directory_iterator(path)) {
+    if (fs::is_regular_file(entry.status())) {
+      files.push_back(entry.path().string());
+    }
+  }
+
+  if (files.empty()) {
+    FATAL(boost::format("Calibration directory '%1%' has no files")
+        %calibration_path_)
+  }
+
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::vector<Quantization::Range> Quantization::Calibrate() {
+  const std::vector<Tensor>& tensors = model_.graph().Tensors();
+  Interpreter interpreter(model_.graph());
+
+  std::vector<Range> ranges(tensors.size(), Range{
+      std::numeric_limits<float>::max(),
+      std::numeric_limits<float>::lowest()});
+
+  for (const auto& file : CalibrationFiles()) {
+    std::ifstream input(file, std::ios::binary | std::ios::ate);
+    size_t size = input.tellg();
+
+    if (size != interpreter.InputSize() * sizeof(float)) {
+      FATAL(boost::format("Calibration file '%1%' has %2% bytes, the FLOAT32 "
+          "inputs of the model take %3% bytes")%file%size
+          %(interpreter.InputSize() * sizeof(float)))
+    }
+
+    std::vector<float> values(interpreter.InputSize());
+    input.seekg(0);
+    input.read(reinterpret_cast<char*>(values.data()), size);
+
+    interpreter.Run(values);
+
+    for (size_t i = 0; i < tensors.size(); i++) {
+      for (float value : interpreter.Values(i)) {
+        ranges[i].min = std::min(ranges[i].min, value);
+        ranges[i].max = std::max(ranges[i].max, value);
+      }
+    }
+  }
+
+  return ranges;
+}
+
+void Quantization::GroupTensors(std::vector<int>& group,
+    std::vector<std::unique_ptr<QuantizationParameters>>& fixed) {
+  for (const auto& op : model_.graph().Operators()) {
+    const std::vector<int>& ins = op.inputs();
+    int output = op.outputs()[0];
+
+    switch (op.op_code().builtin_code) {
+      // NNAPI requires the output with the quantization of the input
+      case BuiltinOperator::RESHAPE:
+      case BuiltinOperator::SQUEEZE:
+      case BuiltinOperator::AVERAGE_POOL_2D:
+      case BuiltinOperator::MAX_POOL_2D:
+      case BuiltinOperator::RELU:
+      case BuiltinOperator::RELU1:
+      case BuiltinOperator::RELU6:
+        JoinGroups(group, output, ins[0]);
+        break;
+
+      case BuiltinOperator::CONCATENATION:
+        for (int in : ins) {
+          JoinGroups(group, output, in);
+        }
+        break;
+
+      // the output range doesn't depend on the input
+      case BuiltinOperator::SOFTMAX:
+      case BuiltinOperator::LOGISTIC:
+        fixed[output] = FixedQuantization(1.0f / 256, 0);
+        break;
+
+      case BuiltinOperator::TANH:
+        fixed[output] = FixedQuantization(1.0f / 128, 128);
+        break;
+
+      case BuiltinOperator::CONV_2D:
+      case BuiltinOperator::DEPTHWISE_CONV_2D:
+      case BuiltinOperator::FULLY_CONNECTED:
+      case BuiltinOperator::L2_POOL_2D:
+      case BuiltinOperator::ADD:
+      case BuiltinOperator::SUB:
+      case BuiltinOperator::MUL:
+      case BuiltinOperator::MAXIMUM:
+      case BuiltinOperator::MINIMUM:
+        break;
+
+      default:
+        FATAL(boost::format("Operator with %1% can't be quantized")
+            %op.builtin_op_str())
+    }
+  }
+}
+
+std::unique_ptr<QuantizationParameters> Quantization::RangeQuantization(
+    Range range) {
+  // the range must hold 0, so the zero padding is exact
+  float min = std::min(range.min, 0.0f);
+  float max = std::max(range.max, 0.0f);
+  float scale = (max - min) / 255;
+
+  // a tensor that is always 0
+  if (scale == 0) {
+    scale = 1;
+  }
+
+  long zero_point = std::lround(-min / scale);
+  zero_point = std::min(std::max(zero_point, 0L), 255L);
+
+  return FixedQuantization(scale, zero_point);
+}
+
+void Quantization::QuantizeBuffer(Tensor& tensor, TensorType type) {
+  const Buffer& buffer = tensor.buffer();
+  float scale = tensor.quantization().scale[0];
+  long zero_point = tensor.quantization().zero_point[0];
+
+  std::vector<float> values = ReadBuffer<float>(buffer);
+  std::vector<u_char> data(values.size() * TensorTypeSize(type));
+
+  for (size_t i = 0; i < values.size(); i++) {
+    long q = std::lround(values[i] / scale) + zero_point;
+
+    if (type == TensorType::INT32) {
+      int32_t q32 = static_cast<int32_t>(q);
+      std::memcpy(data.data() + i * sizeof(q32), &q32, sizeof(q32));
+    } else {
+      data[i] = static_cast<u_char>(std::min(std::max(q, 0L), 255L));
+    }
+  }
+
+  uint buffer_index = model_.AddBuffer(std::move(data));
+  tensor.SetBuffer(model_.Buffers()[buffer_index], buffer_index);
+}
+
+int Quantization::Run() {
+  Graph& graph = model_.graph();
+  std::vector<Tensor>& tensors = graph.Tensors();
+
+  std::vector<Range> ranges = Calibrate();
+
+  std::vector<int> group(tensors.size());
+  for (size_t i = 0; i < group.size(); i++) {
+    group[i] = i;
+  }
+
+  std::vector<std::unique_ptr<QuantizationParameters>> fixed(tensors.size());
+  GroupTensors(group, fixed);
+
+  // the biases are quantized with the scales of the operator inputs, the
+  // other float tensors with the range of their group
+  std::vector<int> bias_of(tensors.size(), -1);
+  std::vector<bool> read_as_value(tensors.size(), false);
+  const std::vector<Operator>& operators = graph.Operators();
+
+  for (size_t i = 0; i < operators.size(); i++) {
+    const Operator& op = operators[i];
+    BuiltinOperator code = op.op_code().builtin_code;
+    bool has_bias = code == BuiltinOperator::CONV_2D ||
+        code == BuiltinOperator::DEPTHWISE_CONV_2D ||
+        code == BuiltinOperator::FULLY_CONNECTED;
+
+    for (size_t j = 0; j < op.inputs().size(); j++) {
+      int in = op.inputs()[j];
+
+      if (in < 0) {
+        continue;
+      }
+
+      if (has_bias && j == 2) {
+        bias_of[in] = i;
+      } else {
+        read_as_value[in] = true;
+      }
+    }
+  }
+
+  std::vector<Range> group_ranges = ranges;
+  std::vector<std::unique_ptr<QuantizationParameters>> group_fixed(
+      tensors.size());
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    if (!IsFloat(tensors[i]) || bias_of[i] >= 0) {
+      continue;
+    }
+
+    int root = FindGroup(group, i);
+    Range& range = group_ranges[root];
+    range.min = std::min(range.min, ranges[i].min);
+    range.max = std::max(range.max, ranges[i].max);
+
+    if (!fixed[i]) {
+      continue;
+    }
+
+    // two fixed quantizations can't be joined
+    if (group_fixed[root] &&
+        group_fixed[root]->scale != fixed[i]->scale) {
+      FATAL(boost::format("Tensor %1% (%2%) needs two different "
+          "quantizations")%i%tensors[i].name())
+    }
+
+    group_fixed[root] = std::move(fixed[i]);
+  }
+
+  int count = 0;
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    Tensor& tensor = tensors[i];
+
+    if (!IsFloat(tensor) || bias_of[i] >= 0) {
+      continue;
+    }
+
+    int root = FindGroup(group, i);
+    if (group_fixed[root]) {
+      tensor.SetQuantization(std::make_unique<QuantizationParameters>(
+          *group_fixed[root]));
+    } else {
+      tensor.SetQuantization(RangeQuantization(group_ranges[root]));
+    }
+
+    if (!tensor.buffer().Empty()) {
+      QuantizeBuffer(tensor, TensorType::UINT8);
+    }
+
+    tensor.SetTensorType(TensorType::UINT8);
+    ++count;
+  }
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    Tensor& tensor = tensors[i];
+
+    if (!IsFloat(tensor) || bias_of[i] < 0) {
+      continue;
+    }
+
+    if (read_as_value[i] || tensor.buffer().Empty()) {
+      FATAL(boost::format("Bias %1% (%2%) must be a constant read only as "
+          "a bias")%i%tensor.name())
+    }
+
+    // the inputs were already quantized above
+    const Operator& op = operators[bias_of[i]];
+    float scale = tensors[op.inputs()[0]].quantization().scale[0] *
+        tensors[op.inputs()[1]].quantization().scale[0];
+
+    // a bias shared by operators with different scales
+    for (const auto& other : operators) {
+      if (other.inputs().size() > 2 && other.inputs()[2] == int(i) &&
+          tensors[other.inputs()[0]].quantization().scale[0] *
+          tensors[other.inputs()[1]].quantization().scale[0] != scale) {
+        FATAL(boost::format("Bias %1% (%2%) is shared by operators with "
+            "different scales")%i%tensor.name())
+      }
+    }
+
+    auto quant = std::make_unique<QuantizationParameters>();
+    quant->scale.push_back(scale);
+    quant->zero_point.push_back(0);
+    tensor.SetQuantization(std::move(quant));
+
+    QuantizeBuffer(tensor, TensorType::INT32);
+    tensor.SetTensorType(TensorType::INT32);
+    ++count;
+  }
+
+  return count;
+}
+
+}
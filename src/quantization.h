@@ -0,0 +1,59 @@
+#ifndef NNT_QUANTIZATION_H
+#define NNT_QUANTIZATION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Post-training quantization of a FLOAT32 model to UINT8. Every file on the
+// calibration directory holds the FLOAT32 inputs of one run, packed in the
+// order of the graph inputs, and the graph is run on the host for each of
+// them to find the range of every tensor. The float tensors become UINT8
+// with the asymmetric quantization of their range, the constants are
+// quantized on new buffers, and the biases of CONV_2D, DEPTHWISE_CONV_2D and
+// FULLY_CONNECTED become INT32 with the scale of the input times the scale of
+// the filter, so the model is generated as any quantized model.
+class Quantization {
+ public:
+  Quantization(Model& model, const std::string& calibration_path)
+    : model_(model)
+    , calibration_path_(calibration_path) {}
+
+  // returns the number of tensors quantized
+  int Run();
+
+ private:
+  struct Range {
+    float min;
+    float max;
+  };
+
+  // files of the calibration directory, sorted by name
+  std::vector<std::string> CalibrationFiles();
+
+  // range of the values of each float tensor on all calibration runs
+  std::vector<Range> Calibrate();
+
+  // tensors that must have the same quantization, the operators that move
+  // the values without computing new ones and the ones with a fixed output
+  // quantization on NNAPI
+  void GroupTensors(std::vector<int>& group,
+      std::vector<std::unique_ptr<QuantizationParameters>>& fixed);
+
+  static std::unique_ptr<QuantizationParameters> RangeQuantization(
+      Range range);
+
+  // quantizes the buffer of a constant with the parameters of the tensor
+  void QuantizeBuffer(Tensor& tensor, TensorType type);
+
+  Model& model_;
+  std::string calibration_path_;
+};
+
+}
+
+#endif  // NNT_QUANTIZATION_H
@@ -0,0 +1,68 @@
+#include "reshape-elimination.h"
+
+namespace nnt {
+
+static bool IsReshape(const Operator& op) {
+  BuiltinOperator code = op.op_code().builtin_code;
+  return code == BuiltinOperator::RESHAPE || code == BuiltinOperator::SQUEEZE;
+}
+
+int ReshapeElimination::Run() {
+  std::vector<Operator>& operators = graph_.Operators();
+  int count = 0;
+
+  // the shape of a RESHAPE is absolute, so it doesn't matter how its input
+  // was reshaped before, the same is not true for SQUEEZE. The operators
+  // bypassed still read their inputs until the dead code elimination
+  // removes them, so the index stays valid during the walk
+  for (auto& op : operators) {
+    if (op.op_code().builtin_code != BuiltinOperator::RESHAPE ||
+        op.inputs().empty()) {
+      continue;
+    }
+
+    int tensor = op.inputs()[0];
+    while (tensor >= 0 && index_.Producer(tensor) >= 0 &&
+        IsReshape(operators[index_.Producer(tensor)]) &&
+        index_.NumConsumers(tensor) == 1 && !index_.IsGraphOutput(tensor)) {
+      const Operator& previous = operators[index_.Producer(tensor)];
+
+      std::vector<int> inputs = op.inputs();
+      inputs[0] = previous.inputs()[0];
+      op.SetInputs(std::move(inputs));
+
+      tensor = op.inputs()[0];
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+std::vector<TensorAlias> ReshapeAliases(const Graph& graph) {
+  const std::vector<Tensor>& tensors = graph.Tensors();
+  std::vector<TensorAlias> aliases(tensors.size());
+
+  for (const auto& op : graph.Operators()) {
+    if (!IsReshape(op) || op.inputs().empty() || op.outputs().size() != 1) {
+      continue;
+    }
+
+    int input = op.inputs()[0];
+    int output = op.outputs()[0];
+
+    if (input < 0 || !tensors[input].buffer().Empty() ||
+        TensorByteSize(tensors[input]) != TensorByteSize(tensors[output])) {
+      continue;
+    }
+
+    // operators are on topological order, so the input was already
+    // resolved
+    aliases[output] = aliases[input].tensor >= 0 ?
+        aliases[input] : TensorAlias{input, 0};
+  }
+
+  return aliases;
+}
+
+}
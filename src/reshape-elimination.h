@@ -0,0 +1,38 @@
+#ifndef NNT_RESHAPE_ELIMINATION_H
+#define NNT_RESHAPE_ELIMINATION_H
+
+#include <vector>
+
+#include "model.h"
+#include "graph-index.h"
+#include "memory-planner.h"
+
+namespace nnt {
+
+// Collapses chains of RESHAPE and SQUEEZE operators: a RESHAPE that reads
+// the output of another RESHAPE or SQUEEZE reads the original tensor
+// instead, the operator left without readers is removed later by the dead
+// code elimination.
+class ReshapeElimination {
+ public:
+  ReshapeElimination(Graph& graph, const GraphIndex& index)
+    : graph_(graph)
+    , index_(index) {}
+
+  // returns the number of operators bypassed
+  int Run();
+
+ private:
+  Graph& graph_;
+  const GraphIndex& index_;
+};
+
+// RESHAPE and SQUEEZE only change the shape, so the output can use the same
+// storage of the input. Returns for each tensor the tensor whose storage it
+// uses, chains are resolved to the first tensor. Constant inputs are not
+// aliased.
+std::vector<TensorAlias> ReshapeAliases(const Graph& graph);
+
+}
+
+#endif  // NNT_RESHAPE_ELIMINATION_H
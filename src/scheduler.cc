@@ -0,0 +1,216 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace nnt {
+
+// tensors read by the operator without repetitions, an operator that uses
+// the same tensor twice is still a single consumer
+static std::vector<int> DistinctInputs(const Operator& op) {
+  std::vector<int> inputs;
+
+  for (int i : op.inputs()) {
+    if (i >= 0 && std::find(inputs.begin(), inputs.end(), i) == inputs.end()) {
+      inputs.push_back(i);
+    }
+  }
+
+  return inputs;
+}
+
+size_t Scheduler::ActivationSize(int index) {
+  const Tensor& tensor = graph_.Tensors()[index];
+
+  if (!tensor.buffer().Empty()) {
+    return 0;
+  }
+
+  return TensorByteSize(tensor);
+}
+
+std::vector<int> Scheduler::CountConsumers() {
+  std::vector<int> consumers(graph_.Tensors().size(), 0);
+
+  for (const auto& op : graph_.Operators()) {
+    for (int i : DistinctInputs(op)) {
+      consumers[i]++;
+    }
+  }
+
+  return consumers;
+}
+
+size_t Scheduler::Simulate(const std::vector<int>& order) {
+  const std::vector<Operator>& operators = graph_.Operators();
+  const std::vector<int>& outputs = graph_.Outputs();
+  std::vector<int> consumers = CountConsumers();
+
+  auto is_output = [&outputs](int index) {
+    return std::find(outputs.begin(), outputs.end(), index) != outputs.end();
+  };
+
+  // only the graph inputs and the operator outputs are allocated, tensors
+  // like the state of an LSTM are neither, so they are never released
+  std::vector<bool> allocated(graph_.Tensors().size(), false);
+
+  size_t live = 0;
+  for (int i : graph_.Inputs()) {
+    live += ActivationSize(i);
+    allocated[i] = true;
+  }
+
+  size_t peak = live;
+
+  for (int op_index : order) {
+    const Operator& op = operators[op_index];
+
+    // outputs are allocated while the inputs are still alive
+    for (int i : op.outputs()) {
+      live += ActivationSize(i);
+      allocated[i] = true;
+    }
+
+    peak = std::max(peak, live);
+
+    for (int i : DistinctInputs(op)) {
+      if (--consumers[i] == 0 && !is_output(i) && allocated[i]) {
+        live -= ActivationSize(i);
+        allocated[i] = false;
+      }
+    }
+
+    // outputs that nobody reads are released right away
+    for (int i : op.outputs()) {
+      if (consumers[i] == 0 && !is_output(i) && allocated[i]) {
+        live -= ActivationSize(i);
+        allocated[i] = false;
+      }
+    }
+  }
+
+  return peak;
+}
+
+std::vector<int> Scheduler::GreedyOrder() {
+  const std::vector<Operator>& operators = graph_.Operators();
+  const std::vector<int>& outputs = graph_.Outputs();
+  std::vector<int> consumers = CountConsumers();
+  int num_ops = operators.size();
+
+  auto is_output = [&outputs](int index) {
+    return std::find(outputs.begin(), outputs.end(), index) != outputs.end();
+  };
+
+  // an operator is ready when every operator that produces one of its
+  // inputs was already scheduled
+  std::vector<int> producer(graph_.Tensors().size(), -1);
+  for (int op = 0; op < num_ops; op++) {
+    for (int i : operators[op].outputs()) {
+      producer[i] = op;
+    }
+  }
+
+  // the tensors Simulate counts as live memory
+  std::vector<bool> allocated(graph_.Tensors().size(), false);
+  for (int i : graph_.Inputs()) {
+    allocated[i] = true;
+  }
+
+  for (size_t i = 0; i < producer.size(); i++) {
+    if (producer[i] >= 0) {
+      allocated[i] = true;
+    }
+  }
+
+  std::vector<int> pending(num_ops, 0);
+  std::vector<std::vector<int>> successors(num_ops);
+  for (int op = 0; op < num_ops; op++) {
+    for (int i : DistinctInputs(operators[op])) {
+      if (producer[i] >= 0) {
+        pending[op]++;
+        successors[producer[i]].push_back(op);
+      }
+    }
+  }
+
+  std::vector<int> ready;
+  for (int op = 0; op < num_ops; op++) {
+    if (pending[op] == 0) {
+      ready.push_back(op);
+    }
+  }
+
+  std::vector<int> order;
+  while (!ready.empty()) {
+    // pick the operator with the smallest growth of live memory, ties go
+    // to the operator that comes first on the original order
+    size_t best = 0;
+    long best_delta = std::numeric_limits<long>::max();
+
+    for (size_t r = 0; r < ready.size(); r++) {
+      const Operator& op = operators[ready[r]];
+      long delta = 0;
+
+      for (int i : op.outputs()) {
+        delta += ActivationSize(i);
+      }
+
+      for (int i : DistinctInputs(op)) {
+        if (consumers[i] == 1 && !is_output(i) && allocated[i]) {
+          delta -= ActivationSize(i);
+        }
+      }
+
+      if (delta < best_delta ||
+          (delta == best_delta && ready[r] < ready[best])) {
+        best = r;
+        best_delta = delta;
+      }
+    }
+
+    int op = ready[best];
+    ready.erase(ready.begin() + best);
+    order.push_back(op);
+
+    for (int i : DistinctInputs(operators[op])) {
+      consumers[i]--;
+    }
+
+    for (int next : successors[op]) {
+      if (--pending[next] == 0) {
+        ready.push_back(next);
+      }
+    }
+  }
+
+  return order;
+}
+
+size_t Scheduler::PeakMemory() {
+  std::vector<int> order(graph_.Operators().size());
+
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+
+  return Simulate(order);
+}
+
+bool Scheduler::Run() {
+  std::vector<int> order = GreedyOrder();
+
+  // a cycle leaves operators out of the order, keep the graph as it is
+  if (order.size() != graph_.Operators().size()) {
+    return false;
+  }
+
+  if (Simulate(order) >= PeakMemory()) {
+    return false;
+  }
+
+  graph_.ReorderOperators(order);
+  return true;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef NNT_SCHEDULER_H
+#define NNT_SCHEDULER_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Reorders the operators of the graph on a topological order that keeps
+// less activation bytes alive at the same time. At each step the ready
+// operator that grows the live memory the least is scheduled, the new order
+// is only kept if its peak is lower than the peak of the original order.
+class Scheduler {
+ public:
+  Scheduler(Graph& graph): graph_(graph) {}
+
+  // returns true if the order of the operators changed
+  bool Run();
+
+  // peak of live activation bytes running the operators on the graph order
+  size_t PeakMemory();
+
+ private:
+  // bytes of the tensor if it is an activation, 0 for constant tensors
+  size_t ActivationSize(int index);
+
+  // number of distinct operators that read each tensor
+  std::vector<int> CountConsumers();
+
+  size_t Simulate(const std::vector<int>& order);
+  std::vector<int> GreedyOrder();
+
+  Graph& graph_;
+};
+
+}
+
+#endif  // NNT_SCHEDULER_H
@@ -0,0 +1,853 @@
+#include "shape-inference.h"
+
+#include <algorithm>
+#include <boost/format.hpp>
+
+#include "exception.h"
+
+namespace nnt {
+
+static std::string ShapeStr(const std::vector<int>& shape) {
+  std::string str = "[";
+
+  for (size_t i = 0; i < shape.size(); i++) {
+    str += (i > 0 ? ", " : "") + std::to_string(shape[i]);
+  }
+
+  return str + "]";
+}
+
+static bool Known(const std::vector<int>& shape) {
+  return std::all_of(shape.begin(), shape.end(),
+      [](int dim) { return dim >= 0; });
+}
+
+// axis on the range [0, rank), negative axes count from the end
+static int NormalizeAxis(int axis, int rank) {
+  int normalized = axis < 0 ? axis + rank : axis;
+
+  if (normalized < 0 || normalized >= rank) {
+    FATAL(boost::format("Axis %1% out of range for rank %2%")%axis%rank)
+  }
+
+  return normalized;
+}
+
+static int WindowOutputSize(Padding padding, int in_size, int filter_size,
+    int stride, int dilation) {
+  if (stride <= 0) {
+    FATAL(boost::format("Stride must be positive, got %1%")%stride)
+  }
+
+  int effective_filter = (filter_size - 1) * dilation + 1;
+
+  if (padding == Padding::SAME) {
+    return (in_size + stride - 1) / stride;
+  }
+
+  int size = (in_size - effective_filter + stride) / stride;
+  if (size <= 0) {
+    FATAL(boost::format("Filter of size %1% doesn't fit on input of size %2% "
+        "without padding")%effective_filter%in_size)
+  }
+
+  return size;
+}
+
+const std::vector<int>& ShapeInference::InputShape(const Operator& op,
+    size_t input) {
+  if (input >= op.inputs().size() || op.inputs()[input] < 0) {
+    FATAL(boost::format("Operator %1% has no input %2%")
+        %op.builtin_op_str()%input)
+  }
+
+  return graph_.Tensors()[op.inputs()[input]].shape();
+}
+
+bool ShapeInference::ConstantInput(const Operator& op, size_t input,
+    std::vector<int>& values) {
+  if (input >= op.inputs().size() || op.inputs()[input] < 0) {
+    return false;
+  }
+
+  const Tensor& tensor = graph_.Tensors()[op.inputs()[input]];
+  const Buffer& buffer = tensor.buffer();
+
+  if (buffer.Empty()) {
+    return false;
+  }
+
+  values.clear();
+
+  if (tensor.tensor_type() == TensorType::INT32) {
+    for (int32_t value : ReadBuffer<int32_t>(buffer)) {
+      values.push_back(value);
+    }
+  } else if (tensor.tensor_type() == TensorType::INT64) {
+    for (int64_t value : ReadBuffer<int64_t>(buffer)) {
+      values.push_back(static_cast<int>(value));
+    }
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+bool ShapeInference::Conv(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  const std::vector<int>& filter = InputShape(op, 1);
+
+  if (input.size() != 4 || filter.size() != 4 || input[3] != filter[3]) {
+    FATAL(boost::format("Conv2D with input %1% and filter %2%")
+        %ShapeStr(input)%ShapeStr(filter))
+  }
+
+  const Conv2DOptions& options =
+      static_cast<const Conv2DOptions&>(op.builtin_op());
+
+  int dilation_w = 1;
+  int dilation_h = 1;
+#ifdef NEWER_TENSORFLOW
+  dilation_w = options.dilation_w_factor;
+  dilation_h = options.dilation_h_factor;
+#endif
+
+  shape = {input[0],
+      WindowOutputSize(options.padding, input[1], filter[1], options.stride_h,
+          dilation_h),
+      WindowOutputSize(options.padding, input[2], filter[2], options.stride_w,
+          dilation_w),
+      filter[0]};
+  return true;
+}
+
+bool ShapeInference::DepthwiseConv(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  const std::vector<int>& filter = InputShape(op, 1);
+
+  const DepthwiseConv2DOptions& options =
+      static_cast<const DepthwiseConv2DOptions&>(op.builtin_op());
+
+  if (input.size() != 4 || filter.size() != 4 ||
+      filter[3] != input[3] * options.depth_multiplier) {
+    FATAL(boost::format("DepthwiseConv2D with input %1%, filter %2% and "
+        "depth multiplier %3%")%ShapeStr(input)%ShapeStr(filter)
+        %options.depth_multiplier)
+  }
+
+  shape = {input[0],
+      WindowOutputSize(options.padding, input[1], filter[1], options.stride_h,
+          1),
+      WindowOutputSize(options.padding, input[2], filter[2], options.stride_w,
+          1),
+      filter[3]};
+  return true;
+}
+
+bool ShapeInference::Pool(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+
+  if (input.size() != 4) {
+    FATAL(boost::format("Pool with input %1%")%ShapeStr(input))
+  }
+
+  const Pool2DOptions& options =
+      static_cast<const Pool2DOptions&>(op.builtin_op());
+
+  shape = {input[0],
+      WindowOutputSize(options.padding, input[1], options.filter_height,
+          options.stride_h, 1),
+      WindowOutputSize(options.padding, input[2], options.filter_width,
+          options.stride_w, 1),
+      input[3]};
+  return true;
+}
+
+bool ShapeInference::FullyConnected(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  const std::vector<int>& weights = InputShape(op, 1);
+
+  // the input is flattened to [batch, depth]
+  size_t elements = NumElements(input);
+  if (weights.size() != 2 || weights[1] <= 0 || elements % weights[1] != 0) {
+    FATAL(boost::format("FullyConnected with input %1% and weights %2%")
+        %ShapeStr(input)%ShapeStr(weights))
+  }
+
+  shape = {static_cast<int>(elements / weights[1]), weights[0]};
+  return true;
+}
+
+bool ShapeInference::Concatenation(const Operator& op,
+    std::vector<int>& shape) {
+  const ConcatenationOptions& options =
+      static_cast<const ConcatenationOptions&>(op.builtin_op());
+
+  shape = InputShape(op, 0);
+  int axis = NormalizeAxis(options.axis, shape.size());
+
+  for (size_t i = 1; i < op.inputs().size(); i++) {
+    const std::vector<int>& input = InputShape(op, i);
+    bool compatible = input.size() == shape.size();
+
+    for (size_t d = 0; compatible && d < input.size(); d++) {
+      compatible = static_cast<int>(d) == axis || input[d] == shape[d];
+    }
+
+    if (!compatible) {
+      FATAL(boost::format("Concatenation of %1% and %2% on axis %3%")
+          %ShapeStr(shape)%ShapeStr(input)%axis)
+    }
+
+    shape[axis] += input[axis];
+  }
+
+  return true;
+}
+
+bool ShapeInference::Broadcast(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& a = InputShape(op, 0);
+  const std::vector<int>& b = InputShape(op, 1);
+
+  // the dimensions are aligned from the end, a dimension of 1 stretches to
+  // the other one
+  size_t rank = std::max(a.size(), b.size());
+  shape.assign(rank, 1);
+
+  for (size_t i = 0; i < rank; i++) {
+    int dim_a = i < a.size() ? a[a.size() - 1 - i] : 1;
+    int dim_b = i < b.size() ? b[b.size() - 1 - i] : 1;
+
+    if (dim_a != dim_b && dim_a != 1 && dim_b != 1) {
+      FATAL(boost::format("Shapes %1% and %2% can't be broadcast")
+          %ShapeStr(a)%ShapeStr(b))
+    }
+
+    shape[rank - 1 - i] = dim_a == 1 ? dim_b : dim_a;
+  }
+
+  return true;
+}
+
+bool ShapeInference::Reshape(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+
+  // the shape input, when it is constant, takes precedence over the options
+  if (!ConstantInput(op, 1, shape)) {
+    if (op.builtin_op().type != BuiltinOptionsType::ReshapeOptions) {
+      return false;
+    }
+
+    shape = static_cast<const ReshapeOptions&>(op.builtin_op()).new_shape;
+  }
+
+  // an empty new shape means a scalar only if the input has one element
+  size_t elements = NumElements(input);
+  if (shape.empty() && elements != 1) {
+    return false;
+  }
+
+  int unknown = -1;
+  size_t known = 1;
+
+  for (size_t i = 0; i < shape.size(); i++) {
+    if (shape[i] == -1 && unknown < 0) {
+      unknown = i;
+    } else if (shape[i] < 0) {
+      FATAL(boost::format("Reshape to %1%")%ShapeStr(shape))
+    } else {
+      known *= shape[i];
+    }
+  }
+
+  if (unknown >= 0 && known > 0) {
+    shape[unknown] = elements / known;
+  }
+
+  if (NumElements(shape) != elements) {
+    FATAL(boost::format("Reshape of %1% to %2%")
+        %ShapeStr(input)%ShapeStr(shape))
+  }
+
+  return true;
+}
+
+bool ShapeInference::Squeeze(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  const SqueezeOptions& options =
+      static_cast<const SqueezeOptions&>(op.builtin_op());
+
+  // without dimensions every dimension of size 1 goes away
+  std::vector<bool> squeezed(input.size(), options.squeeze_dims.empty());
+  for (int dim : options.squeeze_dims) {
+    int axis = NormalizeAxis(dim, input.size());
+
+    if (input[axis] != 1) {
+      FATAL(boost::format("Squeeze of dimension %1% of %2%")
+          %dim%ShapeStr(input))
+    }
+
+    squeezed[axis] = true;
+  }
+
+  shape.clear();
+  for (size_t i = 0; i < input.size(); i++) {
+    if (!squeezed[i] || input[i] != 1) {
+      shape.push_back(input[i]);
+    }
+  }
+
+  return true;
+}
+
+bool ShapeInference::StridedSlice(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> begin, end, strides;
+
+  if (!ConstantInput(op, 1, begin) || !ConstantInput(op, 2, end) ||
+      !ConstantInput(op, 3, strides) ||
+      op.builtin_op().type != BuiltinOptionsType::StridedSliceOptions) {
+    return false;
+  }
+
+  const StridedSliceOptions& options =
+      static_cast<const StridedSliceOptions&>(op.builtin_op());
+
+  // the masks that add or expand dimensions are not inferred
+  if (options.ellipsis_mask != 0 || options.new_axis_mask != 0 ||
+      begin.size() != end.size() || begin.size() != strides.size() ||
+      begin.size() > input.size()) {
+    return false;
+  }
+
+  shape.clear();
+  for (size_t i = 0; i < input.size(); i++) {
+    int dim = input[i];
+
+    if (i >= begin.size()) {
+      shape.push_back(dim);
+      continue;
+    }
+
+    int stride = strides[i];
+    if (stride == 0) {
+      FATAL("StridedSlice with stride 0")
+    }
+
+    // positions are clamped to [0, dim] going forward, and to [-1, dim - 1]
+    // going backward
+    int low = stride > 0 ? 0 : -1;
+    int high = stride > 0 ? dim : dim - 1;
+
+    auto position = [dim, low, high](int value) {
+      value = value < 0 ? value + dim : value;
+      return std::min(std::max(value, low), high);
+    };
+
+    int first = options.begin_mask & (1 << i) ?
+        (stride > 0 ? low : high) : position(begin[i]);
+    int last = options.end_mask & (1 << i) ?
+        (stride > 0 ? high : low) : position(end[i]);
+
+    if (options.shrink_axis_mask & (1 << i)) {
+      continue;
+    }
+
+    int size = stride > 0 ? (last - first + stride - 1) / stride :
+        (first - last - stride - 1) / -stride;
+    shape.push_back(std::max(size, 0));
+  }
+
+  return true;
+}
+
+bool ShapeInference::Mean(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> axes;
+
+  if (!ConstantInput(op, 1, axes)) {
+    return false;
+  }
+
+  bool keep_dims = op.builtin_op().type == BuiltinOptionsType::MeanOptions &&
+      static_cast<const MeanOptions&>(op.builtin_op()).keep_dims;
+
+  std::vector<bool> reduced(input.size(), false);
+  for (int axis : axes) {
+    reduced[NormalizeAxis(axis, input.size())] = true;
+  }
+
+  shape.clear();
+  for (size_t i = 0; i < input.size(); i++) {
+    if (!reduced[i]) {
+      shape.push_back(input[i]);
+    } else if (keep_dims) {
+      shape.push_back(1);
+    }
+  }
+
+  return true;
+}
+
+bool ShapeInference::Pad(const Operator& op, std::vector<int>& shape) {
+  std::vector<int> paddings;
+
+  if (!ConstantInput(op, 1, paddings)) {
+    return false;
+  }
+
+  shape = InputShape(op, 0);
+  if (paddings.size() != shape.size() * 2) {
+    FATAL(boost::format("Pad of %1% with %2% paddings")
+        %ShapeStr(shape)%paddings.size())
+  }
+
+  for (size_t i = 0; i < shape.size(); i++) {
+    shape[i] += paddings[2 * i] + paddings[2 * i + 1];
+  }
+
+  return true;
+}
+
+bool ShapeInference::Gather(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& params = InputShape(op, 0);
+  const std::vector<int>& indices = InputShape(op, 1);
+
+  int axis = op.builtin_op().type == BuiltinOptionsType::GatherOptions ?
+      static_cast<const GatherOptions&>(op.builtin_op()).axis : 0;
+  axis = NormalizeAxis(axis, params.size());
+
+  // the gathered dimension is replaced by the dimensions of the indices
+  shape.assign(params.begin(), params.begin() + axis);
+  shape.insert(shape.end(), indices.begin(), indices.end());
+  shape.insert(shape.end(), params.begin() + axis + 1, params.end());
+  return true;
+}
+
+bool ShapeInference::Transpose(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> perm;
+
+  if (!ConstantInput(op, 1, perm)) {
+    return false;
+  }
+
+  if (perm.size() != input.size()) {
+    FATAL(boost::format("Transpose of %1% with permutation %2%")
+        %ShapeStr(input)%ShapeStr(perm))
+  }
+
+  shape.clear();
+  for (int axis : perm) {
+    shape.push_back(input[NormalizeAxis(axis, input.size())]);
+  }
+
+  return true;
+}
+
+bool ShapeInference::SpaceToDepth(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  int block = static_cast<const SpaceToDepthOptions&>(
+      op.builtin_op()).block_size;
+
+  if (input.size() != 4 || block <= 0 || input[1] % block != 0 ||
+      input[2] % block != 0) {
+    FATAL(boost::format("SpaceToDepth of %1% with block %2%")
+        %ShapeStr(input)%block)
+  }
+
+  shape = {input[0], input[1] / block, input[2] / block,
+      input[3] * block * block};
+  return true;
+}
+
+bool ShapeInference::ResizeBilinear(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> size;
+
+  if (!ConstantInput(op, 1, size)) {
+    return false;
+  }
+
+  if (input.size() != 4 || size.size() != 2) {
+    FATAL(boost::format("ResizeBilinear of %1% to %2%")
+        %ShapeStr(input)%ShapeStr(size))
+  }
+
+  shape = {input[0], size[0], size[1], input[3]};
+  return true;
+}
+
+bool ShapeInference::BatchToSpace(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> block, crops;
+
+  if (!ConstantInput(op, 1, block) || !ConstantInput(op, 2, crops)) {
+    return false;
+  }
+
+  if (input.size() != 4 || block.size() != 2 || crops.size() != 4 ||
+      block[0] <= 0 || block[1] <= 0 ||
+      input[0] % (block[0] * block[1]) != 0) {
+    FATAL(boost::format("BatchToSpaceND of %1% with block %2%")
+        %ShapeStr(input)%ShapeStr(block))
+  }
+
+  shape = {input[0] / (block[0] * block[1]),
+      input[1] * block[0] - crops[0] - crops[1],
+      input[2] * block[1] - crops[2] - crops[3], input[3]};
+  return true;
+}
+
+bool ShapeInference::SpaceToBatch(const Operator& op,
+    std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> block, paddings;
+
+  if (!ConstantInput(op, 1, block) || !ConstantInput(op, 2, paddings)) {
+    return false;
+  }
+
+  if (input.size() != 4 || block.size() != 2 || paddings.size() != 4 ||
+      block[0] <= 0 || block[1] <= 0 ||
+      (input[1] + paddings[0] + paddings[1]) % block[0] != 0 ||
+      (input[2] + paddings[2] + paddings[3]) % block[1] != 0) {
+    FATAL(boost::format("SpaceToBatchND of %1% with block %2%")
+        %ShapeStr(input)%ShapeStr(block))
+  }
+
+  shape = {input[0] * block[0] * block[1],
+      (input[1] + paddings[0] + paddings[1]) / block[0],
+      (input[2] + paddings[2] + paddings[3]) / block[1], input[3]};
+  return true;
+}
+
+bool ShapeInference::ArgMax(const Operator& op, std::vector<int>& shape) {
+  const std::vector<int>& input = InputShape(op, 0);
+  std::vector<int> axis;
+
+  if (!ConstantInput(op, 1, axis) || axis.size() != 1) {
+    return false;
+  }
+
+  int reduced = NormalizeAxis(axis[0], input.size());
+
+  shape = input;
+  shape.erase(shape.begin() + reduced);
+  return true;
+}
+
+bool ShapeInference::Split(const Operator& op,
+    std::vector<std::vector<int>>& shapes) {
+  // the axis comes before the tensor that is split
+  std::vector<int> axis;
+
+  if (!ConstantInput(op, 0, axis) || axis.size() != 1) {
+    return false;
+  }
+
+  std::vector<int> shape = InputShape(op, 1);
+  int splits = op.outputs().size();
+  int dim = NormalizeAxis(axis[0], shape.size());
+
+  if (shape[dim] % splits != 0) {
+    FATAL(boost::format("Split of %1% in %2% parts")
+        %ShapeStr(shape)%splits)
+  }
+
+  shape[dim] /= splits;
+  shapes.assign(splits, shape);
+  return true;
+}
+
+bool ShapeInference::TopK(const Operator& op,
+    std::vector<std::vector<int>>& shapes) {
+  std::vector<int> k;
+
+  if (!ConstantInput(op, 1, k) || k.size() != 1) {
+    return false;
+  }
+
+  // values and indices
+  std::vector<int> shape = InputShape(op, 0);
+  if (shape.empty()) {
+    FATAL("TopKV2 of a scalar")
+  }
+
+  shape.back() = k[0];
+  shapes.assign(2, shape);
+  return true;
+}
+
+bool ShapeInference::Infer(const Operator& op,
+    std::vector<std::vector<int>>& shapes) {
+  std::vector<int> shape;
+  bool inferred;
+
+  auto options_are = [&op](BuiltinOptionsType type) {
+    return op.builtin_op().type == type;
+  };
+
+  switch (op.op_code().builtin_code) {
+    case BuiltinOperator::CONV_2D:
+      inferred = options_are(BuiltinOptionsType::Conv2DOptions) &&
+          Conv(op, shape);
+      break;
+
+    case BuiltinOperator::DEPTHWISE_CONV_2D:
+      inferred = options_are(BuiltinOptionsType::DepthwiseConv2DOptions) &&
+          DepthwiseConv(op, shape);
+      break;
+
+    case BuiltinOperator::AVERAGE_POOL_2D:
+    case BuiltinOperator::MAX_POOL_2D:
+    case BuiltinOperator::L2_POOL_2D:
+      inferred = options_are(BuiltinOptionsType::Pool2DOptions) &&
+          Pool(op, shape);
+      break;
+
+    case BuiltinOperator::FULLY_CONNECTED:
+      inferred = FullyConnected(op, shape);
+      break;
+
+    case BuiltinOperator::CONCATENATION:
+      inferred = options_are(BuiltinOptionsType::ConcatenationOptions) &&
+          Concatenation(op, shape);
+      break;
+
+    case BuiltinOperator::ADD:
+    case BuiltinOperator::SUB:
+    case BuiltinOperator::MUL:
+    case BuiltinOperator::DIV:
+    case BuiltinOperator::MAXIMUM:
+    case BuiltinOperator::MINIMUM:
+    case BuiltinOperator::LESS:
+    case BuiltinOperator::PRELU:
+      inferred = Broadcast(op, shape);
+      break;
+
+    case BuiltinOperator::DEQUANTIZE:
+#ifdef NEWER_TENSORFLOW
+    case BuiltinOperator::FLOOR:
+#endif
+    case BuiltinOperator::L2_NORMALIZATION:
+    case BuiltinOperator::LOCAL_RESPONSE_NORMALIZATION:
+    case BuiltinOperator::LOGISTIC:
+    case BuiltinOperator::RELU:
+    case BuiltinOperator::RELU1:
+    case BuiltinOperator::RELU6:
+    case BuiltinOperator::SOFTMAX:
+    case BuiltinOperator::TANH:
+    case BuiltinOperator::EXP:
+    case BuiltinOperator::LOG_SOFTMAX:
+    case BuiltinOperator::CAST:
+    case BuiltinOperator::NEG:
+      shape = InputShape(op, 0);
+      inferred = true;
+      break;
+
+    case BuiltinOperator::RESHAPE:
+      inferred = Reshape(op, shape);
+      break;
+
+    case BuiltinOperator::SQUEEZE:
+      inferred = options_are(BuiltinOptionsType::SqueezeOptions) &&
+          Squeeze(op, shape);
+      break;
+
+    case BuiltinOperator::STRIDED_SLICE:
+      inferred = StridedSlice(op, shape);
+      break;
+
+    case BuiltinOperator::MEAN:
+      inferred = Mean(op, shape);
+      break;
+
+    case BuiltinOperator::PAD:
+      inferred = Pad(op, shape);
+      break;
+
+    case BuiltinOperator::GATHER:
+      inferred = Gather(op, shape);
+      break;
+
+    case BuiltinOperator::TRANSPOSE:
+      inferred = Transpose(op, shape);
+      break;
+
+    case BuiltinOperator::SPACE_TO_DEPTH:
+      inferred = options_are(BuiltinOptionsType::SpaceToDepthOptions) &&
+          SpaceToDepth(op, shape);
+      break;
+
+    case BuiltinOperator::RESIZE_BILINEAR:
+      inferred = ResizeBilinear(op, shape);
+      break;
+
+    case BuiltinOperator::BATCH_TO_SPACE_ND:
+      inferred = BatchToSpace(op, shape);
+      break;
+
+    case BuiltinOperator::SPACE_TO_BATCH_ND:
+      inferred = SpaceToBatch(op, shape);
+      break;
+
+    case BuiltinOperator::ARG_MAX:
+      inferred = ArgMax(op, shape);
+      break;
+
+    case BuiltinOperator::EMBEDDING_LOOKUP: {
+      // one row of the values for each id
+      const std::vector<int>& values = InputShape(op, 1);
+
+      if (values.empty()) {
+        return false;
+      }
+
+      shape = values;
+      shape[0] = NumElements(InputShape(op, 0));
+      inferred = true;
+      break;
+    }
+
+    case BuiltinOperator::HASHTABLE_LOOKUP: {
+      // the rows found and a hit flag for each key looked up
+      const std::vector<int>& values = InputShape(op, 2);
+      int lookups = NumElements(InputShape(op, 0));
+
+      if (values.empty() || op.outputs().size() != 2) {
+        return false;
+      }
+
+      shape = values;
+      shape[0] = lookups;
+      shapes = {shape, {lookups}};
+      return true;
+    }
+
+    case BuiltinOperator::SPLIT:
+      return Split(op, shapes);
+
+    case BuiltinOperator::TOPK_V2:
+      return TopK(op, shapes);
+
+    default:
+      // recurrent, custom, CALL and the projection operators
+      return false;
+  }
+
+  if (!inferred || op.outputs().size() != 1) {
+    return false;
+  }
+
+  shapes = {shape};
+  return true;
+}
+
+bool ShapeInference::Apply(const Operator& op, int index,
+    std::vector<int>&& shape) {
+  Tensor& tensor = graph_.Tensors()[index];
+  const std::vector<int>& current = tensor.shape();
+
+  if (current == shape) {
+    return false;
+  }
+
+  // an empty shape on the file is only trusted when it is a scalar
+  bool known = Known(current) && !(current.empty() && !shape.empty());
+
+  // another rank is kept when it holds the same elements, e.g. a [1, 10] on
+  // the file for a computed [10], the same rank must be the same shape
+  if (known) {
+    if (current.size() == shape.size() ||
+        NumElements(current) != NumElements(shape)) {
+      FATAL(boost::format("Tensor %1% has shape %2% on the model, but the "
+          "operator with %3% computes %4%")%tensor.name()%ShapeStr(current)
+          %op.builtin_op_str()%ShapeStr(shape))
+    }
+
+    return false;
+  }
+
+  tensor.SetShape(std::move(shape));
+  return true;
+}
+
+const Operator* ShapeInference::FixedOperator() {
+  // every input shape must be known to ask the operators
+  Run();
+
+  const std::vector<Tensor>& tensors = graph_.Tensors();
+  std::vector<bool> written(tensors.size(), false);
+
+  for (int i : graph_.Inputs()) {
+    written[i] = true;
+  }
+
+  for (const auto& op : graph_.Operators()) {
+    for (int i : op.outputs()) {
+      written[i] = true;
+    }
+  }
+
+  for (const auto& op : graph_.Operators()) {
+    std::vector<std::vector<int>> shapes;
+
+    if (!Infer(op, shapes) || shapes.size() != op.outputs().size()) {
+      return &op;
+    }
+
+    for (int i : op.inputs()) {
+      if (i >= 0 && !written[i] && tensors[i].buffer().Empty()) {
+        return &op;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+int ShapeInference::Run() {
+  const std::vector<Tensor>& tensors = graph_.Tensors();
+
+  for (int i : graph_.Inputs()) {
+    if (!Known(tensors[i].shape())) {
+      FATAL(boost::format("Input %1% has unknown shape %2%")
+          %tensors[i].name()%ShapeStr(tensors[i].shape()))
+    }
+  }
+
+  int count = 0;
+
+  for (const auto& op : graph_.Operators()) {
+    std::vector<std::vector<int>> shapes;
+
+    if (!Infer(op, shapes) || shapes.size() != op.outputs().size()) {
+      for (int i : op.outputs()) {
+        if (!Known(tensors[i].shape())) {
+          FATAL(boost::format("Shape of %1% can't be inferred")
+              %tensors[i].name())
+        }
+      }
+
+      continue;
+    }
+
+    for (size_t i = 0; i < shapes.size(); i++) {
+      if (Apply(op, op.outputs()[i], std::move(shapes[i]))) {
+        ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+}
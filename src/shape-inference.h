@@ -0,0 +1,76 @@
+#ifndef NNT_SHAPE_INFERENCE_H
+#define NNT_SHAPE_INFERENCE_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Computes the shape of every tensor written by an operator from the shapes
+// of its inputs and its options, visiting the operators on graph order.
+// Shapes left empty or with negative dimensions by the exporter are filled,
+// known shapes are validated: a shape of the same rank must be the one
+// computed, a shape with another rank is kept as it is on the file if it has
+// the same number of elements, and is an error otherwise. The recurrent,
+// custom and CALL operators, and the operators whose shape depends on a
+// tensor that is not constant, keep the shapes of the file, which must be
+// known.
+class ShapeInference {
+ public:
+  ShapeInference(Graph& graph): graph_(graph) {}
+
+  // returns the number of tensors whose shape was filled
+  int Run();
+
+  // first operator whose output shapes can't be computed again for other
+  // input shapes, nullptr if there is none: an operator the inference
+  // doesn't cover, or one that reads a state tensor, that is neither a
+  // constant, a graph input nor an operator output, and keeps the shape of
+  // the file. The shapes of the file are inferred first.
+  const Operator* FixedOperator();
+
+ private:
+  // shapes of the outputs of the operator, returns false if the operator
+  // can't be inferred
+  bool Infer(const Operator& op, std::vector<std::vector<int>>& shapes);
+
+  // each function returns false if the shape can't be inferred, and fails
+  // if the shapes of the inputs are not valid for the operator
+  bool Conv(const Operator& op, std::vector<int>& shape);
+  bool DepthwiseConv(const Operator& op, std::vector<int>& shape);
+  bool Pool(const Operator& op, std::vector<int>& shape);
+  bool FullyConnected(const Operator& op, std::vector<int>& shape);
+  bool Concatenation(const Operator& op, std::vector<int>& shape);
+  bool Broadcast(const Operator& op, std::vector<int>& shape);
+  bool Reshape(const Operator& op, std::vector<int>& shape);
+  bool Squeeze(const Operator& op, std::vector<int>& shape);
+  bool StridedSlice(const Operator& op, std::vector<int>& shape);
+  bool Mean(const Operator& op, std::vector<int>& shape);
+  bool Pad(const Operator& op, std::vector<int>& shape);
+  bool Gather(const Operator& op, std::vector<int>& shape);
+  bool Transpose(const Operator& op, std::vector<int>& shape);
+  bool SpaceToDepth(const Operator& op, std::vector<int>& shape);
+  bool ResizeBilinear(const Operator& op, std::vector<int>& shape);
+  bool BatchToSpace(const Operator& op, std::vector<int>& shape);
+  bool SpaceToBatch(const Operator& op, std::vector<int>& shape);
+  bool ArgMax(const Operator& op, std::vector<int>& shape);
+  bool Split(const Operator& op, std::vector<std::vector<int>>& shapes);
+  bool TopK(const Operator& op, std::vector<std::vector<int>>& shapes);
+
+  // stores the inferred shape on the tensor, returns true if the shape
+  // was filled
+  bool Apply(const Operator& op, int index, std::vector<int>&& shape);
+
+  const std::vector<int>& InputShape(const Operator& op, size_t input);
+
+  // values of a constant int32 input, false if the input is not constant
+  bool ConstantInput(const Operator& op, size_t input,
+      std::vector<int>& values);
+
+  Graph& graph_;
+};
+
+}
+
+#endif  // NNT_SHAPE_INFERENCE_H
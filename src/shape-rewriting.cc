@@ -0,0 +1,58 @@
+#include "shape-rewriting.h"
+
+#include <boost/format.hpp>
+
+#include "exception.h"
+#include "shape-inference.h"
+
+namespace nnt {
+
+int ShapeRewriting::Run() {
+  std::vector<Tensor>& tensors = graph_.Tensors();
+  const std::vector<int>& inputs = graph_.Inputs();
+
+  if (shapes_.size() != inputs.size()) {
+    FATAL(boost::format("Model has %1% inputs, but %2% shapes were given")
+        %inputs.size()%shapes_.size())
+  }
+
+  if (const Operator* op = ShapeInference(graph_).FixedOperator()) {
+    FATAL(boost::format("Shapes can't be changed, the shapes of operator "
+        "%1% with %2% are not computed again")%op->index()
+        %op->builtin_op_str())
+  }
+
+  int count = 0;
+
+  for (size_t i = 0; i < inputs.size(); i++) {
+    Tensor& tensor = tensors[inputs[i]];
+    const std::vector<int>& shape = shapes_[i];
+
+    if (shape.size() != tensor.shape().size()) {
+      FATAL(boost::format("Input %1% has rank %2%, but the shape given has "
+          "rank %3%")%tensor.name()%tensor.shape().size()%shape.size())
+    }
+
+    for (int dim : shape) {
+      if (dim <= 0) {
+        FATAL(boost::format("Shape of input %1% must be positive")
+            %tensor.name())
+      }
+    }
+
+    if (shape != tensor.shape()) {
+      tensor.SetShape(std::vector<int>(shape));
+      ++count;
+    }
+  }
+
+  for (const auto& op : graph_.Operators()) {
+    for (int i : op.outputs()) {
+      tensors[i].SetShape(std::vector<int>(tensors[i].shape().size(), -1));
+    }
+  }
+
+  return count;
+}
+
+}
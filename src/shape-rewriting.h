@@ -0,0 +1,33 @@
+#ifndef NNT_SHAPE_REWRITING_H
+#define NNT_SHAPE_REWRITING_H
+
+#include <vector>
+
+#include "model.h"
+
+namespace nnt {
+
+// Specializes the graph for other shapes of the inputs: the graph inputs
+// get the new shapes, with the same rank of the file, and every tensor
+// written by an operator is left unknown, so the shape inference computes
+// it again. The constants that depend on the size of the input, like the
+// new shape of a RESHAPE without -1, are not rewritten, so they must still
+// match the new shapes. Models with operators whose shapes are not inferred,
+// like the recurrent ones, are rejected.
+class ShapeRewriting {
+ public:
+  ShapeRewriting(Graph& graph, const std::vector<std::vector<int>>& shapes)
+    : graph_(graph)
+    , shapes_(shapes) {}
+
+  // returns the number of inputs whose shape changed
+  int Run();
+
+ private:
+  Graph& graph_;
+  const std::vector<std::vector<int>>& shapes_;
+};
+
+}
+
+#endif  // NNT_SHAPE_REWRITING_H
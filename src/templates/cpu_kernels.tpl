@@ -0,0 +1,640 @@
+"#ifndef NNC_KERNELS_H\n\
+#define NNC_KERNELS_H\n\
+\n\
+#include <algorithm>\n\
+#include <atomic>\n\
+#include <cmath>\n\
+#include <condition_variable>\n\
+#include <cstdint>\n\
+#include <cstring>\n\
+#include <functional>\n\
+#include <limits>\n\
+#include <mutex>\n\
+#include <thread>\n\
+#include <vector>\n\
+\n\
+namespace nnc {\n\
+namespace kernels {\n\
+\n\
+// Persistent pool of worker threads. ParallelFor splits a range of work\n\
+// items in chunks that are taken by the workers and by the calling thread,\n\
+// the workers sleep between operations, so no thread is created while the\n\
+// model runs.\n\
+class ThreadPool {\n\
+ public:\n\
+  explicit ThreadPool(int num_threads)\n\
+    : task_(nullptr)\n\
+    , size_(0)\n\
+    , chunk_(1)\n\
+    , next_(0)\n\
+    , pending_(0)\n\
+    , generation_(0)\n\
+    , stop_(false) {\n\
+    if (num_threads < 1) {\n\
+      num_threads = 1;\n\
+    }\n\
+\n\
+    for (int i = 1; i < num_threads; i++) {\n\
+      workers_.emplace_back([this]() { Worker(); });\n\
+    }\n\
+  }\n\
+\n\
+  ~ThreadPool() {\n\
+    {\n\
+      std::unique_lock<std::mutex> lock(mutex_);\n\
+      stop_ = true;\n\
+    }\n\
+\n\
+    cv_start_.notify_all();\n\
+\n\
+    for (auto& worker : workers_) {\n\
+      worker.join();\n\
+    }\n\
+  }\n\
+\n\
+  ThreadPool(const ThreadPool&) = delete;\n\
+  ThreadPool& operator=(const ThreadPool&) = delete;\n\
+\n\
+  int NumThreads() const {\n\
+    return static_cast<int>(workers_.size()) + 1;\n\
+  }\n\
+\n\
+  // calls fn(begin, end) for chunks that cover [0, size), chunks are never\n\
+  // smaller than min_chunk items\n\
+  template<class Fn>\n\
+  void ParallelFor(int64_t size, int64_t min_chunk, Fn&& fn) {\n\
+    if (size <= 0) {\n\
+      return;\n\
+    }\n\
+\n\
+    int64_t num_threads = NumThreads();\n\
+\n\
+    if (num_threads == 1 || size <= min_chunk) {\n\
+      fn(int64_t(0), size);\n\
+      return;\n\
+    }\n\
+\n\
+    // a few chunks per thread balance the work without much contention\n\
+    int64_t chunk = std::max(min_chunk, (size + num_threads * 4 - 1) /\n\
+        (num_threads * 4));\n\
+\n\
+    std::function<void(int64_t, int64_t)> task(fn);\n\
+\n\
+    {\n\
+      std::unique_lock<std::mutex> lock(mutex_);\n\
+      task_ = &task;\n\
+      size_ = size;\n\
+      chunk_ = chunk;\n\
+      next_.store(0);\n\
+      pending_ = static_cast<int>(workers_.size());\n\
+      ++generation_;\n\
+    }\n\
+\n\
+    cv_start_.notify_all();\n\
+    RunChunks();\n\
+\n\
+    std::unique_lock<std::mutex> lock(mutex_);\n\
+    cv_done_.wait(lock, [this]() { return pending_ == 0; });\n\
+    task_ = nullptr;\n\
+  }\n\
+\n\
+ private:\n\
+  void RunChunks() {\n\
+    for (;;) {\n\
+      int64_t begin = next_.fetch_add(chunk_);\n\
+\n\
+      if (begin >= size_) {\n\
+        break;\n\
+      }\n\
+\n\
+      (*task_)(begin, std::min(begin + chunk_, size_));\n\
+    }\n\
+  }\n\
+\n\
+  void Worker() {\n\
+    uint64_t generation = 0;\n\
+\n\
+    for (;;) {\n\
+      {\n\
+        std::unique_lock<std::mutex> lock(mutex_);\n\
+        cv_start_.wait(lock, [&]() {\n\
+          return stop_ || generation_ != generation;\n\
+        });\n\
+\n\
+        if (stop_) {\n\
+          return;\n\
+        }\n\
+\n\
+        generation = generation_;\n\
+      }\n\
+\n\
+      RunChunks();\n\
+\n\
+      std::unique_lock<std::mutex> lock(mutex_);\n\
+      if (--pending_ == 0) {\n\
+        cv_done_.notify_one();\n\
+      }\n\
+    }\n\
+  }\n\
+\n\
+  std::vector<std::thread> workers_;\n\
+  std::mutex mutex_;\n\
+  std::condition_variable cv_start_;\n\
+  std::condition_variable cv_done_;\n\
+  const std::function<void(int64_t, int64_t)>* task_;\n\
+  int64_t size_;\n\
+  int64_t chunk_;\n\
+  std::atomic<int64_t> next_;\n\
+  int pending_;\n\
+  uint64_t generation_;\n\
+  bool stop_;\n\
+};\n\
+\n\
+// NHWC shape, tensors with less than 4 dimensions are aligned to the right\n\
+struct Shape {\n\
+  int32_t n;\n\
+  int32_t h;\n\
+  int32_t w;\n\
+  int32_t c;\n\
+\n\
+  int64_t FlatSize() const {\n\
+    return int64_t(n) * h * w * c;\n\
+  }\n\
+};\n\
+\n\
+enum class Activation { NONE, RELU, RELU1, RELU6 };\n\
+\n\
+inline void ActivationRange(Activation act, float* min, float* max) {\n\
+  *min = std::numeric_limits<float>::lowest();\n\
+  *max = std::numeric_limits<float>::max();\n\
+\n\
+  switch (act) {\n\
+    case Activation::RELU:\n\
+      *min = 0.0f;\n\
+      break;\n\
+\n\
+    case Activation::RELU1:\n\
+      *min = -1.0f;\n\
+      *max = 1.0f;\n\
+      break;\n\
+\n\
+    case Activation::RELU6:\n\
+      *min = 0.0f;\n\
+      *max = 6.0f;\n\
+      break;\n\
+\n\
+    default:\n\
+      break;\n\
+  }\n\
+}\n\
+\n\
+inline float Clamp(float v, float min, float max) {\n\
+  return std::min(std::max(v, min), max);\n\
+}\n\
+\n\
+// filter is [out_c, kh, kw, in_c], bias is [out_c] or null\n\
+inline void Conv2D(ThreadPool& pool, const float* input, Shape in,\n\
+    const float* filter, Shape fs, const float* bias, float* output,\n\
+    Shape out, int stride_w, int stride_h, int dilation_w, int dilation_h,\n\
+    int pad_w, int pad_h, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  pool.ParallelFor(int64_t(out.n) * out.h, 1, [&](int64_t begin,\n\
+      int64_t end) {\n\
+    for (int64_t row = begin; row < end; row++) {\n\
+      int b = static_cast<int>(row / out.h);\n\
+      int oy = static_cast<int>(row % out.h);\n\
+      const float* in_b = input + int64_t(b) * in.h * in.w * in.c;\n\
+      float* out_row = output + row * out.w * out.c;\n\
+\n\
+      for (int ox = 0; ox < out.w; ox++) {\n\
+        float* out_px = out_row + int64_t(ox) * out.c;\n\
+        int iy0 = oy * stride_h - pad_h;\n\
+        int ix0 = ox * stride_w - pad_w;\n\
+\n\
+        for (int oc = 0; oc < out.c; oc++) {\n\
+          const float* f_oc = filter + int64_t(oc) * fs.h * fs.w * fs.c;\n\
+          float acc = bias ? bias[oc] : 0.0f;\n\
+\n\
+          for (int ky = 0; ky < fs.h; ky++) {\n\
+            int iy = iy0 + ky * dilation_h;\n\
+\n\
+            if (iy < 0 || iy >= in.h) {\n\
+              continue;\n\
+            }\n\
+\n\
+            for (int kx = 0; kx < fs.w; kx++) {\n\
+              int ix = ix0 + kx * dilation_w;\n\
+\n\
+              if (ix < 0 || ix >= in.w) {\n\
+                continue;\n\
+              }\n\
+\n\
+              const float* in_px = in_b + (int64_t(iy) * in.w + ix) * in.c;\n\
+              const float* f_px = f_oc + (int64_t(ky) * fs.w + kx) * fs.c;\n\
+\n\
+              for (int ic = 0; ic < in.c; ic++) {\n\
+                acc += in_px[ic] * f_px[ic];\n\
+              }\n\
+            }\n\
+          }\n\
+\n\
+          out_px[oc] = Clamp(acc, act_min, act_max);\n\
+        }\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+// filter is [1, kh, kw, in_c * depth_multiplier]\n\
+inline void DepthwiseConv2D(ThreadPool& pool, const float* input, Shape in,\n\
+    const float* filter, Shape fs, const float* bias, float* output,\n\
+    Shape out, int stride_w, int stride_h, int dilation_w, int dilation_h,\n\
+    int pad_w, int pad_h, int depth_multiplier, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  pool.ParallelFor(int64_t(out.n) * out.h, 1, [&](int64_t begin,\n\
+      int64_t end) {\n\
+    std::vector<float> acc(out.c);\n\
+\n\
+    for (int64_t row = begin; row < end; row++) {\n\
+      int b = static_cast<int>(row / out.h);\n\
+      int oy = static_cast<int>(row % out.h);\n\
+      const float* in_b = input + int64_t(b) * in.h * in.w * in.c;\n\
+      float* out_row = output + row * out.w * out.c;\n\
+\n\
+      for (int ox = 0; ox < out.w; ox++) {\n\
+        int iy0 = oy * stride_h - pad_h;\n\
+        int ix0 = ox * stride_w - pad_w;\n\
+\n\
+        for (int oc = 0; oc < out.c; oc++) {\n\
+          acc[oc] = bias ? bias[oc] : 0.0f;\n\
+        }\n\
+\n\
+        for (int ky = 0; ky < fs.h; ky++) {\n\
+          int iy = iy0 + ky * dilation_h;\n\
+\n\
+          if (iy < 0 || iy >= in.h) {\n\
+            continue;\n\
+          }\n\
+\n\
+          for (int kx = 0; kx < fs.w; kx++) {\n\
+            int ix = ix0 + kx * dilation_w;\n\
+\n\
+            if (ix < 0 || ix >= in.w) {\n\
+              continue;\n\
+            }\n\
+\n\
+            const float* in_px = in_b + (int64_t(iy) * in.w + ix) * in.c;\n\
+            const float* f_px = filter + (int64_t(ky) * fs.w + kx) * fs.c;\n\
+\n\
+            if (depth_multiplier == 1) {\n\
+              for (int c = 0; c < out.c; c++) {\n\
+                acc[c] += in_px[c] * f_px[c];\n\
+              }\n\
+            } else {\n\
+              for (int ic = 0; ic < in.c; ic++) {\n\
+                for (int m = 0; m < depth_multiplier; m++) {\n\
+                  int oc = ic * depth_multiplier + m;\n\
+                  acc[oc] += in_px[ic] * f_px[oc];\n\
+                }\n\
+              }\n\
+            }\n\
+          }\n\
+        }\n\
+\n\
+        float* out_px = out_row + int64_t(ox) * out.c;\n\
+        for (int oc = 0; oc < out.c; oc++) {\n\
+          out_px[oc] = Clamp(acc[oc], act_min, act_max);\n\
+        }\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+// input is [batches, depth], weights is [units, depth]\n\
+inline void FullyConnected(ThreadPool& pool, const float* input,\n\
+    int64_t batches, int64_t depth, const float* weights, const float* bias,\n\
+    float* output, int64_t units, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  pool.ParallelFor(units, 4, [&](int64_t begin, int64_t end) {\n\
+    for (int64_t b = 0; b < batches; b++) {\n\
+      const float* in_b = input + b * depth;\n\
+      float* out_b = output + b * units;\n\
+\n\
+      for (int64_t u = begin; u < end; u++) {\n\
+        const float* w_u = weights + u * depth;\n\
+        float acc = 0.0f;\n\
+\n\
+        for (int64_t d = 0; d < depth; d++) {\n\
+          acc += in_b[d] * w_u[d];\n\
+        }\n\
+\n\
+        if (bias) {\n\
+          acc += bias[u];\n\
+        }\n\
+\n\
+        out_b[u] = Clamp(acc, act_min, act_max);\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+// weights are 4 bits, two on each byte with the lower one first, stored as\n\
+// the value plus 8, every group of group_size weights of a unit has its own\n\
+// scale, the partial sum of a group is scaled once\n\
+inline void FullyConnectedInt4(ThreadPool& pool, const float* input,\n\
+    int64_t batches, int64_t depth, const uint8_t* weights,\n\
+    const float* scales, int64_t group_size, const float* bias,\n\
+    float* output, int64_t units, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+  int64_t groups = depth / group_size;\n\
+\n\
+  pool.ParallelFor(units, 4, [&](int64_t begin, int64_t end) {\n\
+    for (int64_t b = 0; b < batches; b++) {\n\
+      const float* in_b = input + b * depth;\n\
+      float* out_b = output + b * units;\n\
+\n\
+      for (int64_t u = begin; u < end; u++) {\n\
+        const uint8_t* w_u = weights + u * depth / 2;\n\
+        const float* s_u = scales + u * groups;\n\
+        float acc = 0.0f;\n\
+\n\
+        for (int64_t g = 0; g < groups; g++) {\n\
+          const uint8_t* w_g = w_u + g * group_size / 2;\n\
+          const float* in_g = in_b + g * group_size;\n\
+          float partial = 0.0f;\n\
+\n\
+          for (int64_t d = 0; d < group_size / 2; d++) {\n\
+            uint8_t packed = w_g[d];\n\
+            partial += in_g[2 * d] * float(int(packed & 0xf) - 8);\n\
+            partial += in_g[2 * d + 1] * float(int(packed >> 4) - 8);\n\
+          }\n\
+\n\
+          acc += partial * s_u[g];\n\
+        }\n\
+\n\
+        if (bias) {\n\
+          acc += bias[u];\n\
+        }\n\
+\n\
+        out_b[u] = Clamp(acc, act_min, act_max);\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+enum class PoolType { AVERAGE, MAX, L2 };\n\
+\n\
+inline void Pool2D(ThreadPool& pool, PoolType type, const float* input,\n\
+    Shape in, float* output, Shape out, int filter_w, int filter_h,\n\
+    int stride_w, int stride_h, int pad_w, int pad_h, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  pool.ParallelFor(int64_t(out.n) * out.h, 1, [&](int64_t begin,\n\
+      int64_t end) {\n\
+    std::vector<float> acc(out.c);\n\
+\n\
+    for (int64_t row = begin; row < end; row++) {\n\
+      int b = static_cast<int>(row / out.h);\n\
+      int oy = static_cast<int>(row % out.h);\n\
+      const float* in_b = input + int64_t(b) * in.h * in.w * in.c;\n\
+      float* out_row = output + row * out.w * out.c;\n\
+\n\
+      for (int ox = 0; ox < out.w; ox++) {\n\
+        int iy0 = oy * stride_h - pad_h;\n\
+        int ix0 = ox * stride_w - pad_w;\n\
+        int y_begin = std::max(0, iy0);\n\
+        int y_end = std::min(in.h, iy0 + filter_h);\n\
+        int x_begin = std::max(0, ix0);\n\
+        int x_end = std::min(in.w, ix0 + filter_w);\n\
+        int count = (y_end - y_begin) * (x_end - x_begin);\n\
+\n\
+        std::fill(acc.begin(), acc.end(), type == PoolType::MAX ?\n\
+            std::numeric_limits<float>::lowest() : 0.0f);\n\
+\n\
+        for (int iy = y_begin; iy < y_end; iy++) {\n\
+          for (int ix = x_begin; ix < x_end; ix++) {\n\
+            const float* in_px = in_b + (int64_t(iy) * in.w + ix) * in.c;\n\
+\n\
+            for (int c = 0; c < in.c; c++) {\n\
+              switch (type) {\n\
+                case PoolType::AVERAGE:\n\
+                  acc[c] += in_px[c];\n\
+                  break;\n\
+\n\
+                case PoolType::MAX:\n\
+                  acc[c] = std::max(acc[c], in_px[c]);\n\
+                  break;\n\
+\n\
+                case PoolType::L2:\n\
+                  acc[c] += in_px[c] * in_px[c];\n\
+                  break;\n\
+              }\n\
+            }\n\
+          }\n\
+        }\n\
+\n\
+        float* out_px = out_row + int64_t(ox) * out.c;\n\
+        for (int c = 0; c < out.c; c++) {\n\
+          float v = acc[c];\n\
+\n\
+          if (type == PoolType::AVERAGE) {\n\
+            v = count > 0 ? v / count : 0.0f;\n\
+          } else if (type == PoolType::L2) {\n\
+            v = count > 0 ? std::sqrt(v / count) : 0.0f;\n\
+          }\n\
+\n\
+          out_px[c] = Clamp(v, act_min, act_max);\n\
+        }\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+// inputs are seen as [outer, input_sizes[i]] and are copied side by side\n\
+inline void Concatenation(ThreadPool& pool, const float* const* inputs,\n\
+    const int64_t* input_sizes, int num_inputs, int64_t outer,\n\
+    float* output, Activation act) {\n\
+  int64_t out_size = 0;\n\
+  for (int i = 0; i < num_inputs; i++) {\n\
+    out_size += input_sizes[i];\n\
+  }\n\
+\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  pool.ParallelFor(outer, 1, [&](int64_t begin, int64_t end) {\n\
+    for (int64_t o = begin; o < end; o++) {\n\
+      float* out = output + o * out_size;\n\
+\n\
+      for (int i = 0; i < num_inputs; i++) {\n\
+        const float* in = inputs[i] + o * input_sizes[i];\n\
+\n\
+        if (act == Activation::NONE) {\n\
+          std::memcpy(out, in, input_sizes[i] * sizeof(float));\n\
+        } else {\n\
+          for (int64_t k = 0; k < input_sizes[i]; k++) {\n\
+            out[k] = Clamp(in[k], act_min, act_max);\n\
+          }\n\
+        }\n\
+\n\
+        out += input_sizes[i];\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+inline void Softmax(ThreadPool& pool, const float* input, float* output,\n\
+    int64_t rows, int64_t depth, float beta) {\n\
+  pool.ParallelFor(rows, 1, [&](int64_t begin, int64_t end) {\n\
+    for (int64_t r = begin; r < end; r++) {\n\
+      const float* in = input + r * depth;\n\
+      float* out = output + r * depth;\n\
+      float max = *std::max_element(in, in + depth);\n\
+      float sum = 0.0f;\n\
+\n\
+      for (int64_t d = 0; d < depth; d++) {\n\
+        out[d] = std::exp((in[d] - max) * beta);\n\
+        sum += out[d];\n\
+      }\n\
+\n\
+      for (int64_t d = 0; d < depth; d++) {\n\
+        out[d] /= sum;\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+enum class UnaryOp { RELU, RELU1, RELU6, TANH, LOGISTIC, EXP, NEG };\n\
+\n\
+inline void Unary(ThreadPool& pool, UnaryOp op, const float* input,\n\
+    float* output, int64_t size) {\n\
+  pool.ParallelFor(size, 4096, [&](int64_t begin, int64_t end) {\n\
+    for (int64_t i = begin; i < end; i++) {\n\
+      float v = input[i];\n\
+\n\
+      switch (op) {\n\
+        case UnaryOp::RELU:\n\
+          v = std::max(v, 0.0f);\n\
+          break;\n\
+\n\
+        case UnaryOp::RELU1:\n\
+          v = Clamp(v, -1.0f, 1.0f);\n\
+          break;\n\
+\n\
+        case UnaryOp::RELU6:\n\
+          v = Clamp(v, 0.0f, 6.0f);\n\
+          break;\n\
+\n\
+        case UnaryOp::TANH:\n\
+          v = std::tanh(v);\n\
+          break;\n\
+\n\
+        case UnaryOp::LOGISTIC:\n\
+          v = 1.0f / (1.0f + std::exp(-v));\n\
+          break;\n\
+\n\
+        case UnaryOp::EXP:\n\
+          v = std::exp(v);\n\
+          break;\n\
+\n\
+        case UnaryOp::NEG:\n\
+          v = -v;\n\
+          break;\n\
+      }\n\
+\n\
+      output[i] = v;\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+enum class BinaryOp { ADD, SUB, MUL, DIV, MAXIMUM, MINIMUM };\n\
+\n\
+inline float ApplyBinary(BinaryOp op, float a, float b) {\n\
+  switch (op) {\n\
+    case BinaryOp::ADD:\n\
+      return a + b;\n\
+\n\
+    case BinaryOp::SUB:\n\
+      return a - b;\n\
+\n\
+    case BinaryOp::MUL:\n\
+      return a * b;\n\
+\n\
+    case BinaryOp::DIV:\n\
+      return a / b;\n\
+\n\
+    case BinaryOp::MAXIMUM:\n\
+      return std::max(a, b);\n\
+\n\
+    case BinaryOp::MINIMUM:\n\
+      return std::min(a, b);\n\
+  }\n\
+\n\
+  return 0.0f;\n\
+}\n\
+\n\
+// numpy style broadcast between a and b, every dimension of a and b is\n\
+// either 1 or equal to the output dimension\n\
+inline void Binary(ThreadPool& pool, BinaryOp op, const float* a, Shape as,\n\
+    const float* b, Shape bs, float* output, Shape out, Activation act) {\n\
+  float act_min, act_max;\n\
+  ActivationRange(act, &act_min, &act_max);\n\
+\n\
+  bool same_shape = as.n == bs.n && as.h == bs.h && as.w == bs.w &&\n\
+      as.c == bs.c;\n\
+\n\
+  if (same_shape) {\n\
+    pool.ParallelFor(out.FlatSize(), 4096, [&](int64_t begin, int64_t end) {\n\
+      for (int64_t i = begin; i < end; i++) {\n\
+        output[i] = Clamp(ApplyBinary(op, a[i], b[i]), act_min, act_max);\n\
+      }\n\
+    });\n\
+\n\
+    return;\n\
+  }\n\
+\n\
+  pool.ParallelFor(int64_t(out.n) * out.h, 1, [&](int64_t begin,\n\
+      int64_t end) {\n\
+    for (int64_t row = begin; row < end; row++) {\n\
+      int n = static_cast<int>(row / out.h);\n\
+      int y = static_cast<int>(row % out.h);\n\
+      int64_t a_row = (int64_t(as.n == 1 ? 0 : n) * as.h +\n\
+          (as.h == 1 ? 0 : y)) * as.w;\n\
+      int64_t b_row = (int64_t(bs.n == 1 ? 0 : n) * bs.h +\n\
+          (bs.h == 1 ? 0 : y)) * bs.w;\n\
+      float* out_row = output + row * out.w * out.c;\n\
+\n\
+      for (int x = 0; x < out.w; x++) {\n\
+        const float* a_px = a + (a_row + (as.w == 1 ? 0 : x)) * as.c;\n\
+        const float* b_px = b + (b_row + (bs.w == 1 ? 0 : x)) * bs.c;\n\
+        float* out_px = out_row + int64_t(x) * out.c;\n\
+\n\
+        for (int c = 0; c < out.c; c++) {\n\
+          float v = ApplyBinary(op, a_px[as.c == 1 ? 0 : c],\n\
+              b_px[bs.c == 1 ? 0 : c]);\n\
+          out_px[c] = Clamp(v, act_min, act_max);\n\
+        }\n\
+      }\n\
+    }\n\
+  });\n\
+}\n\
+\n\
+inline void Copy(const void* input, void* output, int64_t bytes) {\n\
+  if (input != output) {\n\
+    std::memmove(output, input, bytes);\n\
+  }\n\
+}\n\
+\n\
+}  // namespace kernels\n\
+}  // namespace nnc\n\
+\n\
+#endif  // NNC_KERNELS_H\n\
+"
@@ -0,0 +1,101 @@
+"namespace nnc {\n\
+\n\
+struct Variant {\n\
+  bool (*open_training_data)(const char* file_name);\n\
+  bool (*create_model)();\n\
+  bool (*compile)(int32_t preference);\n\
+  bool (*build_model)();\n\
+  bool (*execute)();\n\
+  void (*cleanup)();\n\
+  bool (*set_input)(const int8_t *buffer);\n\
+  bool (*set_output)(int8_t *buffer);\n\
+  size_t input_size;\n\
+  size_t output_size;\n\
+};\n\
+\n\
+// every variant is built up front, so changing the size of the input only\n\
+// changes the variant that runs\n\
+static const Variant kVariants[] = {\n\
+@VARIANTS\
+};\n\
+\n\
+static size_t current = 0;\n\
+\n\
+bool OpenTrainingData(const char* file_name) {\n\
+  for (const Variant& variant : kVariants) {\n\
+    if (!variant.open_training_data(file_name)) {\n\
+      return false;\n\
+    }\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+bool CreateModel() {\n\
+  for (const Variant& variant : kVariants) {\n\
+    if (!variant.create_model()) {\n\
+      return false;\n\
+    }\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+bool Compile(int32_t preference) {\n\
+  for (const Variant& variant : kVariants) {\n\
+    if (!variant.compile(preference)) {\n\
+      return false;\n\
+    }\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+bool BuildModel() {\n\
+  for (const Variant& variant : kVariants) {\n\
+    if (!variant.build_model()) {\n\
+      return false;\n\
+    }\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+void Cleanup() {\n\
+  for (const Variant& variant : kVariants) {\n\
+    variant.cleanup();\n\
+  }\n\
+}\n\
+\n\
+bool Execute() {\n\
+  return kVariants[current].execute();\n\
+}\n\
+\n\
+bool SetInput(const int8_t *buffer) {\n\
+  return kVariants[current].set_input(buffer);\n\
+}\n\
+\n\
+bool SetOutput(int8_t *buffer) {\n\
+  return kVariants[current].set_output(buffer);\n\
+}\n\
+\n\
+size_t InputSize() {\n\
+  return kVariants[current].input_size;\n\
+}\n\
+\n\
+size_t OutputSize() {\n\
+  return kVariants[current].output_size;\n\
+}\n\
+\n\
+bool SetInput(const int8_t *buffer, size_t size) {\n\
+  for (size_t i = 0; i < sizeof(kVariants) / sizeof(kVariants[0]); i++) {\n\
+    if (kVariants[i].input_size == size) {\n\
+      current = i;\n\
+      return SetInput(buffer);\n\
+    }\n\
+  }\n\
+\n\
+  return false;\n\
+}\n\
+\n\
+"
@@ -0,0 +1,62 @@
+"// the floats are stored as fp16 on the weights file, they are widened to\n\
+// float32 when the file is loaded\n\
+struct Segment {\n\
+  size_t file_offset;\n\
+  size_t offset;\n\
+  size_t size;\n\
+  bool half;\n\
+};\n\
+\n\
+static const Segment kSegments[] = {\n\
+@SEGMENTS};\n\
+\n\
+static const size_t kFileSize = @FILE_SIZE;\n\
+\n\
+static float HalfToFloat(uint16_t half) {\n\
+  uint32_t sign = uint32_t(half & 0x8000) << 16;\n\
+  uint32_t exponent = (half >> 10) & 0x1f;\n\
+  uint32_t mantissa = half & 0x3ff;\n\
+  uint32_t bits;\n\
+\n\
+  if (exponent == 0x1f) {\n\
+    bits = sign | 0x7f800000 | (mantissa << 13);\n\
+  } else if (exponent != 0) {\n\
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);\n\
+  } else if (mantissa == 0) {\n\
+    bits = sign;\n\
+  } else {\n\
+    exponent = 113;\n\
+    while ((mantissa & 0x400) == 0) {\n\
+      mantissa <<= 1;\n\
+      exponent--;\n\
+    }\n\
+\n\
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);\n\
+  }\n\
+\n\
+  float value;\n\
+  memcpy(&value, &bits, sizeof(value));\n\
+  return value;\n\
+}\n\
+\n\
+static void WidenWeights(const uint8_t* file, uint8_t* image) {\n\
+  for (const Segment& segment : kSegments) {\n\
+    if (!segment.half) {\n\
+      memcpy(image + segment.offset, file + segment.file_offset,\n\
+          segment.size);\n\
+      continue;\n\
+    }\n\
+\n\
+    for (size_t i = 0; i < segment.size / sizeof(float); i++) {\n\
+      uint16_t half;\n\
+      memcpy(&half, file + segment.file_offset + i * sizeof(half),\n\
+          sizeof(half));\n\
+\n\
+      float value = HalfToFloat(half);\n\
+      memcpy(image + segment.offset + i * sizeof(value), &value,\n\
+          sizeof(value));\n\
+    }\n\
+  }\n\
+}\n\
+\n\
+"
@@ -1,5 +1,6 @@
 "#include <jni.h>\n\
 #include <string>\n\
+#include <vector>\n\
 #include \"nn.h\"\n\
 \n\
 jint throwException(JNIEnv *env, std::string message) {\n\
@@ -72,11 +73,6 @@ JNICALL\n\
     jobject /* this */,\n\
     jbyteArray input_data) {\n\
   jsize input_len = env->GetArrayLength(input_data);\n\
-\n\
-  if (input_len != @TOTAL_INPUT_SIZE) {\n\
-    throwException(env, \"Input data has wrong length\");\n\
-    return;\n\
-  }\n\
 \n\
   jbyte *bytes = env->GetByteArrayElements(input_data, 0);\n\
 \n\
@@ -85,9 +81,10 @@ JNICALL\n\
     return;\n\
   }\n\
 \n\
-  if (!nnc::SetInput(bytes)) {\n\
+  if (!nnc::SetInput(bytes, input_len)) {\n\
     env->ReleaseByteArrayElements(input_data, bytes, JNI_ABORT);\n\
-    throwException(env, \"Error on execute model\");\n\
+    throwException(env, \"Error on set input of \" +\n\
+        std::to_string(input_len) + \" bytes\");\n\
     return;\n\
   }\n\
 \n\
@@ -100,20 +97,22 @@ JNICALL\n\
 @JAVA_PACKAGE_getOutput(\n\
     JNIEnv *env,\n\
     jobject /* this */) {\n\
+  jsize output_len = nnc::OutputSize();\n\
   jbyteArray result;\n\
-  result = env->NewByteArray(@TOTAL_OUTPUT_SIZE);\n\
+  result = env->NewByteArray(output_len);\n\
   if (result == NULL) {\n\
     throwException(env, \"out of memory\");\n\
     return NULL; /* out of memory error thrown */\n\
   }\n\
 \n\
-  jbyte data[@TOTAL_OUTPUT_SIZE];\n\
-  if (!nnc::SetOutput(data)) {\n\
+  // the outputs of a batched model can be too large for the stack\n\
+  std::vector<jbyte> data(output_len);\n\
+  if (!nnc::SetOutput(data.data())) {\n\
     throwException(env, \"Error on execute model\");\n\
     return NULL;\n\
   }\n\
 \n\
-  env->SetByteArrayRegion(result, 0, @TOTAL_OUTPUT_SIZE, data);\n\
+  env->SetByteArrayRegion(result, 0, output_len, data.data());\n\
   return result;\n\
 }\n\
 "
@@ -0,0 +1,26 @@
+"// the weights are widened from the mapped file to memory of their own\n\
+static bool LoadWeights() {\n\
+  if (weights_size < kFileSize) {\n\
+    fprintf(stderr, \"weights file has %zu bytes, expected %zu\\n\",\n\
+        weights_size, kFileSize);\n\
+    return false;\n\
+  }\n\
+\n\
+  size_t size = (kWeightsSize + 63) & ~size_t(63);\n\
+  uint8_t* image = static_cast<uint8_t*>(aligned_alloc(64, size));\n\
+\n\
+  if (image == NULL) {\n\
+    fprintf(stderr, \"weights allocation of %zu bytes failed\\n\", size);\n\
+    return false;\n\
+  }\n\
+\n\
+  WidenWeights(weights, image);\n\
+  munmap(weights, weights_size);\n\
+\n\
+  weights = image;\n\
+  weights_size = kWeightsSize;\n\
+  weights_mapped = false;\n\
+  return true;\n\
+}\n\
+\n\
+"
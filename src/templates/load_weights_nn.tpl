@@ -0,0 +1,48 @@
+"static const size_t kWeightsSize = @WEIGHTS_SIZE;\n\
+\n\
+// the weights are widened from the file to a shared memory region, that\n\
+// takes the place of the file for NNAPI, on failure *fd is still the file\n\
+// and the caller closes it\n\
+static bool LoadWeights(int* fd, size_t* size) {\n\
+  if (*size < kFileSize) {\n\
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n\
+                        \"weights file has %zu bytes, expected %zu\",\n\
+                        *size, kFileSize);\n\
+    return false;\n\
+  }\n\
+\n\
+  void* file = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, *fd, 0);\n\
+  if (file == MAP_FAILED) {\n\
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, \"mmap failed\");\n\
+    return false;\n\
+  }\n\
+\n\
+  int image_fd = ASharedMemory_create(\"weights\", kWeightsSize);\n\
+  if (image_fd < 0) {\n\
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n\
+                        \"ASharedMemory_create failed\");\n\
+    munmap(file, *size);\n\
+    return false;\n\
+  }\n\
+\n\
+  void* image = mmap(NULL, kWeightsSize, PROT_READ | PROT_WRITE, MAP_SHARED,\n\
+                     image_fd, 0);\n\
+  if (image == MAP_FAILED) {\n\
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, \"mmap failed\");\n\
+    munmap(file, *size);\n\
+    close(image_fd);\n\
+    return false;\n\
+  }\n\
+\n\
+  WidenWeights(static_cast<const uint8_t*>(file),\n\
+               static_cast<uint8_t*>(image));\n\
+  munmap(image, kWeightsSize);\n\
+  munmap(file, *size);\n\
+  close(*fd);\n\
+\n\
+  *fd = image_fd;\n\
+  *size = kWeightsSize;\n\
+  return true;\n\
+}\n\
+\n\
+"
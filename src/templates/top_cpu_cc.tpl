@@ -0,0 +1,127 @@
+"#include <sys/types.h>\n\
+#include <sys/mman.h>\n\
+#include <sys/stat.h>\n\
+#include <unistd.h>\n\
+#include <fcntl.h>\n\
+#include <cstdio>\n\
+#include <cstdlib>\n\
+#include <cstring>\n\
+#include <memory>\n\
+#include <thread>\n\
+\n\
+#include \"nn.h\"\n\
+#include \"nn_kernels.h\"\n\
+\n\
+namespace nnc {\n\
+\n\
+static const size_t kArenaSize = @ARENA_SIZE;\n\
+static const size_t kWeightsSize = @WEIGHTS_SIZE;\n\
+\n\
+static uint8_t* weights = NULL;\n\
+static size_t weights_size = 0;\n\
+static bool weights_mapped = false;\n\
+static uint8_t* arena = NULL;\n\
+static std::unique_ptr<kernels::ThreadPool> pool;\n\
+static int num_threads = 0;\n\
+\n\
+template<class T>\n\
+static inline T* Arena(size_t offset) {\n\
+  return reinterpret_cast<T*>(arena + offset);\n\
+}\n\
+\n\
+template<class T>\n\
+static inline const T* Weights(size_t offset) {\n\
+  return reinterpret_cast<const T*>(weights + offset);\n\
+}\n\
+\n\
+@LOAD_WEIGHTS\
+void SetNumThreads(int threads) {\n\
+  num_threads = threads;\n\
+}\n\
+\n\
+bool OpenTrainingData(const char* file_name) {\n\
+  int fd = open(file_name, O_RDONLY);\n\
+\n\
+  if (fd < 0) {\n\
+    fprintf(stderr, \"open failed: %s\\n\", file_name);\n\
+    return false;\n\
+  }\n\
+\n\
+  struct stat sb;\n\
+  if (fstat(fd, &sb) != 0) {\n\
+    fprintf(stderr, \"fstat failed: %s\\n\", file_name);\n\
+    close(fd);\n\
+    return false;\n\
+  }\n\
+\n\
+  weights_size = sb.st_size;\n\
+\n\
+  // the weights are used in place from the mapped file\n\
+  if (weights_size > 0) {\n\
+    void* addr = mmap(NULL, weights_size, PROT_READ, MAP_PRIVATE, fd, 0);\n\
+\n\
+    if (addr == MAP_FAILED) {\n\
+      fprintf(stderr, \"mmap failed: %s\\n\", file_name);\n\
+      close(fd);\n\
+      return false;\n\
+    }\n\
+\n\
+    weights = static_cast<uint8_t*>(addr);\n\
+    weights_mapped = true;\n\
+  }\n\
+\n\
+  close(fd);\n\
+  return LoadWeights();\n\
+}\n\
+\n\
+bool CreateModel() {\n\
+  int threads = num_threads;\n\
+\n\
+  if (threads <= 0) {\n\
+    threads = std::thread::hardware_concurrency();\n\
+  }\n\
+\n\
+  pool.reset(new kernels::ThreadPool(threads));\n\
+\n\
+  // aligned_alloc requires a size multiple of the alignment\n\
+  size_t size = (kArenaSize + 63) & ~size_t(63);\n\
+  arena = static_cast<uint8_t*>(aligned_alloc(64, size > 0 ? size : 64));\n\
+\n\
+  if (arena == NULL) {\n\
+    fprintf(stderr, \"arena allocation of %zu bytes failed\\n\", size);\n\
+    return false;\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+bool Compile(int32_t /*preference*/) {\n\
+  return pool && arena != NULL;\n\
+}\n\
+\n\
+bool BuildModel() {\n\
+  if (weights_size < kWeightsSize) {\n\
+    fprintf(stderr, \"weights file has %zu bytes, expected %zu\\n\",\n\
+        weights_size, kWeightsSize);\n\
+    return false;\n\
+  }\n\
+\n\
+  return true;\n\
+}\n\
+\n\
+void Cleanup() {\n\
+  pool.reset();\n\
+  free(arena);\n\
+  arena = NULL;\n\
+\n\
+  if (weights != NULL && weights_mapped) {\n\
+    munmap(weights, weights_size);\n\
+  } else {\n\
+    free(weights);\n\
+  }\n\
+\n\
+  weights = NULL;\n\
+}\n\
+\n\
+bool Execute() {\n\
+"
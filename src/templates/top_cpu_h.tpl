@@ -0,0 +1,23 @@
+"#include <cstddef>\n\
+#include <cstdint>\n\
+\n\
+namespace nnc {\n\
+\n\
+void SetNumThreads(int threads);\n\
+bool OpenTrainingData(const char* file_name);\n\
+bool CreateModel();\n\
+bool Compile(int32_t preference);\n\
+bool Execute();\n\
+void Cleanup();\n\
+bool BuildModel();\n\
+bool SetInput(const int8_t *buffer);\n\
+bool SetOutput(int8_t *buffer);\n\
+\n\
+// bytes of the inputs and of the outputs\n\
+size_t InputSize();\n\
+size_t OutputSize();\n\
+\n\
+// fails if the inputs don't have this size, on a model with variants it\n\
+// selects the variant whose inputs have this size\n\
+bool SetInput(const int8_t *buffer, size_t size);\n\
+"
@@ -5,6 +5,8 @@
 #include <fcntl.h>\n\
 #include <android/log.h>\n\
 #include <android/NeuralNetworks.h>\n\
+#include <android/sharedmem.h>\n\
+#include <cstring>\n\
 #include <string>\n\
 \n\
 #include \"nn.h\"\n\
@@ -19,6 +21,7 @@ static ANeuralNetworksModel* model = NULL;\n\
 static ANeuralNetworksCompilation* compilation = NULL;\n\
 static ANeuralNetworksExecution* run = NULL;\n\
 \n\
+@LOAD_WEIGHTS\
 bool OpenTrainingData(const char* file_name) {\n\
   int fd = open(file_name, O_RDONLY);\n\
 \n\
@@ -31,10 +34,17 @@ bool OpenTrainingData(const char* file_name) {\n\
   struct stat sb;\n\
   fstat(fd, &sb);\n\
   size_t buffer_size_bytes = sb.st_size;\n\
+\n\
+  if (!LoadWeights(&fd, &buffer_size_bytes)) {\n\
+    close(fd);\n\
+    return false;\n\
+  }\n\
+\n\
   int status = ANeuralNetworksMemory_createFromFd(buffer_size_bytes, PROT_READ, fd, 0, &mem);\n\
   if (status != ANEURALNETWORKS_NO_ERROR) {\n\
     __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,\n\
                         \"ANeuralNetworksMemory_createFromFd failed\");\n\
+    close(fd);\n\
     return false;\n\
   }\n\
 \n\
@@ -143,7 +153,5 @@ bool AddScalarFloat32(int32_t id, float value) {\n\
 }\n\
 \n\
 bool BuildModel() {\n\
-  int tensor_size = 0;\n\
-  int offset = 0;\n\
   int status;\n\
  ";
@@ -8,4 +8,12 @@ void Cleanup();\n\
 bool BuildModel();\n\
 bool SetInput(const int8_t *buffer);\n\
 bool SetOutput(int8_t *buffer);\n\
+\n\
+// bytes of the inputs and of the outputs\n\
+size_t InputSize();\n\
+size_t OutputSize();\n\
+\n\
+// fails if the inputs don't have this size, on a model with variants it\n\
+// selects the variant whose inputs have this size\n\
+bool SetInput(const int8_t *buffer, size_t size);\n\
 "